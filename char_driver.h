@@ -6,7 +6,7 @@
 #define REG_SIZE 1         // size of 1 register 1 byte (8 bits)
 #define NUM_CTRL_REGS 1    // number of control register
 #define NUM_STS_REGS 5     // number of status register
-#define NUM_DATA_REGS 256  // number of data register
+#define NUM_DATA_REGS 256  // default number of data register (module parameter data_size)
 #define NUM_DEV_REGS (NUM_CTRL_REGS + NUM_STS_REGS + NUM_DATA_REGS) // total register
 
 /****************** Description of Status Register: START ******************/
@@ -39,13 +39,17 @@
  *   bit2:
  *       0: if data registers were cleared, set bit to 0
  *       1: if all data registers were written, set bit to 1
- *   bit3~7: unused
+ *   bit3:
+ *       0: data registers are addressed by offset
+ *       1: data registers work as a FIFO
+ *   bit4~7: unused
  */
 #define DEVICE_STATUS_REG 4
 
 #define STS_READ_ACCESS_BIT (1 << 0)
 #define STS_WRITE_ACCESS_BIT (1 << 1)
 #define STS_DATAREGS_OVERFLOW_BIT (1 << 2)
+#define STS_FIFO_MODE_BIT (1 << 3)
 
 #define READY 1
 #define NOT_READY 0
@@ -66,12 +70,16 @@
  *   bit1:
  *       0: do not allow write on data registers
  *       1: allow write on data registers
- *   bit2~7: unused
+ *   bit2:
+ *       0: read/write access data registers at the file offset
+ *       1: write appends to and read consumes from a FIFO over data registers
+ *   bit3~7: unused
  */
 #define CONTROL_ACCESS_REG 0
 
 #define CTRL_READ_DATA_BIT (1 << 0)
 #define CTRL_WRITE_DATA_BIT (1 << 1)
+#define CTRL_FIFO_MODE_BIT (1 << 2)
 
 #define ENABLE 1
 #define DISABLE 0
@@ -0,0 +1,3159 @@
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt /* Prefix of messages */
+
+#include <linux/module.h>  /* Include macros such as, module_init & module_exit */
+#include <linux/fs.h>      /* Define init/free functions for device number*/
+#include <linux/device.h>  /* Include functions for creating device file*/
+#include <linux/slab.h>    /* Include: kmalloc & kfree*/
+#include <linux/vmalloc.h> /* Include: vmalloc_user & vfree*/
+#include <linux/mm.h>      /* Include functions for memory mapping*/
+#include <linux/percpu.h>  /* Include functions for per-CPU statistics counters*/
+#include <linux/cdev.h>    /* Include functions for operate with cdev*/
+#include <linux/uaccess.h> /* Include functions for data exchange between user and kernel*/
+#include <linux/ioctl.h>   /* Include functions for ioctl operation */
+#include <linux/wait.h>    /* Include functions for blocking read/write */
+#include <linux/poll.h>    /* Include functions for poll operation */
+#include <linux/uio.h>     /* Include functions for vectored read/write */
+#include <linux/version.h> /* Include: LINUX_VERSION_CODE */
+#include <linux/file.h>    /* Include functions for installing file descriptors */
+#include <linux/anon_inodes.h> /* Include functions for snapshot files */
+#include <linux/ktime.h>   /* Include functions for measuring latency */
+#include <linux/jump_label.h> /* Include: static keys (latency measurement off by default) */
+#include <linux/debugfs.h> /* Include functions for latency histograms files */
+#include <linux/seq_file.h> /* Include functions for showing latency histograms */
+#include <linux/list.h>    /* Include functions for lists of open files */
+#include <linux/spinlock.h> /* Include functions for locking lists of open files */
+#include <linux/sched.h>   /* Include: current, get_task_comm */
+#include <linux/eventfd.h> /* Include functions for event notification */
+#include <linux/rculist.h> /* Include functions for lists of event subscribers */
+#include <linux/math64.h>  /* Include: div64_u64 */
+#include <linux/splice.h>  /* Include functions for splice/sendfile */
+#include <linux/pipe_fs_i.h> /* Include functions for lending snapshot pages to pipes */
+#include <linux/dma-buf.h> /* Include functions for exporting data registers as dma-buf */
+#include <linux/dma-mapping.h> /* Include functions for mapping dma-buf pages for importing devices */
+#include <linux/scatterlist.h> /* Include functions for scatter lists of dma-buf pages */
+#include <linux/highmem.h> /* Include: flush_kernel_vmap_range, invalidate_kernel_vmap_range */
+#include <linux/hrtimer.h> /* Include functions for completions of the timing model */
+#include <linux/workqueue.h> /* Include functions for the bottom half of simulated interrupts */
+#include <linux/kthread.h> /* Include: kthread_use_mm (transfers in the bottom half) */
+#include <linux/sched/mm.h> /* Include functions for holding address spaces of submitters */
+#include <linux/llist.h>   /* Include functions for lists of raised interrupts */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 7, 0)
+#include <linux/io_uring/cmd.h> /* Include functions for io_uring command passthrough */
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(5, 19, 0)
+#include <linux/io_uring.h> /* Include functions for io_uring command passthrough */
+#endif
+
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(5, 13, 0)
+#error "char_driver supports Linux 5.13 and later"
+#endif
+
+#include "char_hw.h"       /* Include register model of char_driver (DEVICE SPECIFIC part) */
+
+#define CREATE_TRACE_POINTS
+#include "char_driver_trace.h" /* Include tracepoints of char_driver */
+
+#define DRIVER_AUTHOR "La Nhat Hy <lahyus7399@gmail.com>"
+#define DRIVER_DESC   "A sample virtual character device driver"
+#define DRIVER_VERSION "0.9"
+#define DRIVER_MAX_DEVICES 64
+
+/* Define ioctl commands code */
+#define MAGICAL_NUMBER 243
+#define CHAR_CLR_DATA_REGS _IO(MAGICAL_NUMBER, 0) // Clear data registers
+#define CHAR_GET_STS_REGS _IOR(MAGICAL_NUMBER, 1, sts_regs_t *) // Get status from status register
+#define CHAR_SET_RD_DATA_REGS _IOW(MAGICAL_NUMBER, 2, unsigned char *) // Set reading permission for data registers
+#define CHAR_SET_WR_DATA_REGS _IOW(MAGICAL_NUMBER, 3, unsigned char *) // Set writing permission for data registers
+#define CHAR_GET_STATS _IOR(MAGICAL_NUMBER, 4, char_stats_t) // Get 64-bit statistics counters
+#define CHAR_SET_FIFO_MODE _IOW(MAGICAL_NUMBER, 5, unsigned char *) // Set FIFO mode for data registers
+#define CHAR_READ_RANGE _IOW(MAGICAL_NUMBER, 6, char_range_t) // Read a range of data registers
+#define CHAR_WRITE_RANGE _IOW(MAGICAL_NUMBER, 7, char_range_t) // Write a range of data registers
+#define CHAR_BATCH _IOWR(MAGICAL_NUMBER, 8, char_batch_t) // Execute several commands in one call
+#define CHAR_GET_DIRTY _IOWR(MAGICAL_NUMBER, 9, char_dirty_t) // Get data registers written since an epoch
+#define CHAR_SNAPSHOT _IOWR(MAGICAL_NUMBER, 10, char_snapshot_t) // Take a snapshot of data registers
+#define CHAR_SET_FILE_FLAGS _IOW(MAGICAL_NUMBER, 11, u32) // Set view flags of the file descriptor
+#define CHAR_SET_EVENTFD _IOW(MAGICAL_NUMBER, 12, char_eventfd_t) // Signal an eventfd on device events
+#define CHAR_CRC32C _IOWR(MAGICAL_NUMBER, 13, char_region_t) // Compute CRC32C of a range of data registers
+#define CHAR_FILL _IOWR(MAGICAL_NUMBER, 14, char_region_t) // Fill a range of data registers with a pattern
+#define CHAR_COMPARE _IOWR(MAGICAL_NUMBER, 15, char_region_t) // Compare a range of data registers with a buffer
+#define CHAR_ATOMIC _IOWR(MAGICAL_NUMBER, 16, char_atomic_t) // Atomic read-modify-write of a data register
+#define CHAR_EXPORT_DMABUF _IOWR(MAGICAL_NUMBER, 17, char_dmabuf_export_t) // Export data registers as a dma-buf
+#define CHAR_ASYNC_SUBMIT _IOWR(MAGICAL_NUMBER, 18, char_async_submit_t) // Submit asynchronous reads/writes
+#define CHAR_ASYNC_REAP _IOWR(MAGICAL_NUMBER, 19, char_async_reap_t) // Reap completions of asynchronous reads/writes
+
+/* Commands of CHAR_BATCH */
+#define CHAR_BATCH_CLR_DATA_REGS 0    // clear data registers
+#define CHAR_BATCH_SET_RD_DATA_REGS 1 // set reading permission (arg: ENABLE/DISABLE)
+#define CHAR_BATCH_SET_WR_DATA_REGS 2 // set writing permission (arg: ENABLE/DISABLE)
+#define CHAR_BATCH_GET_STS_REGS 3     // get status registers (addr: sts_regs_t)
+#define CHAR_BATCH_READ_RANGE 4       // read len registers from offset into addr
+#define CHAR_BATCH_WRITE_RANGE 5      // write len registers at offset from addr
+
+#define CHAR_BATCH_STOP_ON_ERROR (1 << 0) // do not execute commands after a failed one
+#define CHAR_BATCH_MAX_CMDS 64
+#define CHAR_BATCH_MAX_DATA (1 << 20) // registers read/written by all commands (-E2BIG above)
+
+/*
+	io_uring commands (IORING_OP_URING_CMD): cmd_op is one of the ioctl commands above,
+	the command area of the SQE holds char_uring_cmd_t whose arg is the ioctl argument
+*/
+
+/* Dirty tracking of data registers
+	* data registers are split into chunks of 2^dirty_shift bytes (a cache line at least,
+	  a page at most), each chunk remembers the epoch in which it was last written
+	* CHAR_GET_DIRTY starts a new epoch and returns chunks written since the epoch
+	  returned by the previous query (epoch 0: all data registers), optionally with their data
+	* writes through a shared writable mapping are not seen: while such a mapping exists
+	  (or existed since the given epoch), all data registers are reported dirty
+*/
+
+/* Snapshots of data registers
+	* CHAR_SNAPSHOT returns a read-only file holding data registers as they were at that time,
+	  closing the file releases the snapshot (one snapshot per device at a time)
+	* copy-on-write: the first write to a stripe after the snapshot copies the old stripe
+	  into the snapshot, snapshot reads take the copy or the (unchanged) live stripe
+	* a snapshot is mappable once all stripes are copied (CHAR_SNAPSHOT_COPY)
+	* writes through mappings cannot be caught: CHAR_SNAPSHOT fails with -EBUSY while a shared
+	  writable mapping (or writable dma-buf) exists, and no such mapping can be created while it lives
+*/
+#define CHAR_SNAPSHOT_COPY (1 << 0) // copy all data registers now (snapshot can be mapped)
+
+/* Open files
+	* each open() gets its own context (filp->private_data): view flags, statistics counters
+	  and a staging buffer, so calls through one descriptor only write state of that descriptor
+	* open files of a device are listed with their counters in debugfs
+	  (<debugfs>/char_driver/char_device_file<N>/clients)
+*/
+#define CHAR_FILE_RAW (1 << 0) // access data registers by offset, even in FIFO mode
+#define CHAR_FILE_FLAGS CHAR_FILE_RAW
+#define CHAR_FILE_STAGING_SIZE PAGE_SIZE // commands of a batch, then their data
+
+/* Event notification
+	* CHAR_SET_EVENTFD subscribes an eventfd to events of the device, supervisors wait for it
+	  with poll/epoll/read instead of polling status registers; the subscription ends when
+	  the eventfd is registered again with no events, or when the file is closed
+	* CHAR_EVENT_THRESHOLD fires each time the number of reads + writes of the device crosses
+	  a multiple of threshold (checked every CHAR_HW_COUNT_PERIOD operations of a CPU, so it
+	  fires up to CHAR_HW_COUNT_PERIOD operations per CPU late)
+*/
+#define CHAR_EVENT_PERM (1 << 0)      // read/write permission or FIFO mode changed
+#define CHAR_EVENT_OVERFLOW (1 << 1)  // STS_DATAREGS_OVERFLOW_BIT got set
+#define CHAR_EVENT_CLEAR (1 << 2)     // data registers were cleared
+#define CHAR_EVENT_THRESHOLD (1 << 3) // reads + writes crossed a multiple of threshold
+#define CHAR_EVENTS (CHAR_EVENT_PERM | CHAR_EVENT_OVERFLOW | CHAR_EVENT_CLEAR | CHAR_EVENT_THRESHOLD)
+#define CHAR_FILE_MAX_EVENTFDS 16
+
+/* Checksum, fill and compare of data registers (in the device layer, data stays in the kernel)
+	* CHAR_CRC32C: CRC32C (Castagnoli, as in iSCSI/ext4) of a range, chained through the seed
+	* CHAR_FILL: repeat a pattern of up to CHAR_FILL_MAX_PATTERN bytes over a range
+	* CHAR_COMPARE: compare a range with a user buffer, return the first differing register
+*/
+#define CHAR_FILL_MAX_PATTERN 64
+#define CHAR_COMPARE_CHUNK (64 * 1024) // user buffer is compared chunk by chunk
+
+/* Atomic read-modify-write of a naturally aligned 1/2/4/8-byte data register (CHAR_ATOMIC)
+	* the register is updated with one atomic instruction, so the operations are atomic
+	  relative to the same operations done with atomic instructions on a mapping of data
+	  registers (e.g. __atomic_fetch_add() on the mmap'd address), in any process
+	* the value before the operation is returned, the operation counts as a write
+	  of size bytes (also when a compare-and-swap does not store)
+*/
+#define CHAR_ATOMIC_ADD 0  // fetch-add (wraps around)
+#define CHAR_ATOMIC_CAS 1  // compare-and-swap: store value if the register holds expected
+#define CHAR_ATOMIC_XCHG 2 // swap
+#define CHAR_ATOMIC_AND 3  // fetch-and
+#define CHAR_ATOMIC_OR 4   // fetch-or
+
+/* dma-buf export of data registers (CHAR_EXPORT_DMABUF)
+	* a page aligned range of data registers is exported as a dma-buf file descriptor:
+	  drivers import it (dma_buf_get/attach/map_attachment), processes mmap it; its pages
+	  are the data registers themselves, nothing is copied
+	* CPU access is bracketed with DMA_BUF_IOCTL_SYNC (begin/end CPU access), which syncs
+	  the mappings of importing devices with the CPU caches
+	* exports follow the permission bits of CONTROL_ACCESS_REG at the time they are made,
+	  importing devices write only into a writable export; mappings of the dma-buf check
+	  the permission bits on fault and are revoked with device mappings, DMA mappings
+	  of importing devices are not
+	* a writable export counts as a shared writable mapping while the dma-buf lives
+	  (see CHAR_SNAPSHOT, dirty tracking)
+	* a dma-buf holds a reference to the module, which cannot be unloaded until the
+	  last importer and mapping of the dma-buf went away
+*/
+#define CHAR_DMABUF_WRITE (1 << 0) // importers may write (needs writing permission)
+
+/* Asynchronous reads/writes and timing model of the device
+	* CHAR_ASYNC_SUBMIT queues reads/writes of data registers, each one completes when the
+	  timing model says the device is done: transfers are serialized at the bandwidth,
+	  latencies overlap, jitter adds a random latency (sysfs: model/latency_ns,
+	  model/bandwidth, model/jitter_ns, defaults: module parameters model_*)
+	* a completion raises a simulated interrupt (hrtimer in hard interrupt context), whose
+	  bottom half (a worker) transfers the data, queues the completion on the file and
+	  wakes it up
+	* CHAR_ASYNC_REAP returns completions, waiting for min_nr of them; poll reports
+	  EPOLLPRI while completions wait to be reaped
+	* data moves when the device completes a request, in the address space of the
+	  submitter: the user buffer must stay valid until the completion is reaped; errors
+	  (permissions, faults) are reported by the completion, checked at that time
+	* the model is fed with the range clamped to the data registers; read()/write() and
+	  the other commands are not delayed
+	* up to CHAR_ASYNC_MAX_REQS requests of a file are in flight or wait to be reaped,
+	  closing the file cancels requests in flight
+*/
+#define CHAR_ASYNC_READ 0
+#define CHAR_ASYNC_WRITE 1
+#define CHAR_ASYNC_MAX_REQS 256
+
+/* Latency histograms of entry points
+	* off by default: enabled with the latency_hist module parameter
+	  (/sys/module/char_driver/parameters/latency_hist), a static key keeps disabled
+	  histograms (and tracepoints) from reading the clock on every operation
+	* per CPU, merged when shown in debugfs (<debugfs>/char_driver/char_device_file<N>/latency),
+	  writing to the file resets them
+	* bucket b counts latencies in [2^(b-1), 2^b) ns, the last bucket everything above
+	* operations: char_io operations of tracepoints, open/release, then ioctl/io_uring
+	  commands by number
+*/
+#define CHAR_HIST_OPEN (CHAR_OP_MMAP + 1)
+#define CHAR_HIST_RELEASE (CHAR_OP_MMAP + 2)
+#define CHAR_HIST_CMD_BASE (CHAR_OP_MMAP + 3)
+#define CHAR_HIST_NR_CMDS 32
+#define CHAR_HIST_NR_OPS (CHAR_HIST_CMD_BASE + CHAR_HIST_NR_CMDS)
+#define CHAR_HIST_NR_BUCKETS 40
+
+/* Module parameters */
+static unsigned long long model_latency_ns;
+module_param(model_latency_ns, ullong, 0444);
+MODULE_PARM_DESC(model_latency_ns, "Timing model: latency of each asynchronous read/write in ns (default 0)");
+
+static unsigned long long model_bandwidth;
+module_param(model_bandwidth, ullong, 0444);
+MODULE_PARM_DESC(model_bandwidth, "Timing model: transfer rate in bytes per second (default 0: unlimited)");
+
+static unsigned long long model_jitter_ns;
+module_param(model_jitter_ns, ullong, 0444);
+MODULE_PARM_DESC(model_jitter_ns, "Timing model: random extra latency in ns, up to this value (default 0)");
+
+static unsigned long data_size = NUM_DATA_REGS * REG_SIZE;
+module_param(data_size, ulong, 0444);
+MODULE_PARM_DESC(data_size, "Size of data registers region in bytes (default 256)");
+
+static unsigned int num_devices = 1;
+module_param(num_devices, uint, 0444);
+MODULE_PARM_DESC(num_devices, "Number of device instances char_device_file0..N-1 (default 1)");
+
+static int numa_node[DRIVER_MAX_DEVICES] = { [0 ... DRIVER_MAX_DEVICES - 1] = NUMA_NO_NODE };
+static int num_numa_node;
+module_param_array(numa_node, int, &num_numa_node, 0444);
+MODULE_PARM_DESC(numa_node, "NUMA node of buffers of each instance (default: any node)");
+
+static unsigned int dirty_shift = L1_CACHE_SHIFT;
+module_param(dirty_shift, uint, 0444);
+MODULE_PARM_DESC(dirty_shift, "Dirty tracking granularity (log2 bytes, cache line to page, default cache line)");
+
+static DEFINE_STATIC_KEY_FALSE(char_hist_key); // latency histograms are enabled
+static bool latency_hist;
+
+/* Function: Enable/disable latency histograms when the latency_hist parameter changes */
+static int char_hist_param_set(const char *val, const struct kernel_param *kp)
+{
+	int ret = param_set_bool(val, kp);
+
+	if(ret < 0)
+		return ret;
+	if(latency_hist)
+		static_branch_enable(&char_hist_key);
+	else
+		static_branch_disable(&char_hist_key);
+	return 0;
+}
+
+static const struct kernel_param_ops char_hist_param_ops =
+{
+	.set = char_hist_param_set,
+	.get = param_get_bool,
+};
+module_param_cb(latency_hist, &char_hist_param_ops, &latency_hist, 0644);
+MODULE_PARM_DESC(latency_hist, "Measure latency histograms of entry points (default 0, writable at run time)");
+
+// Range of data registers for CHAR_READ_RANGE/CHAR_WRITE_RANGE
+typedef struct
+{
+	u64 offset;  // start data register
+	u64 addr;    // address of user buffer
+	u32 len;     // number of registers
+	u32 flags;   // must be 0
+} char_range_t;
+
+// Command of CHAR_BATCH
+typedef struct
+{
+	u32 op;      // CHAR_BATCH_* command
+	s32 result;  // returns: registers read/written, 0 or negative error code
+	u64 offset;  // start data register
+	u64 addr;    // address of user buffer
+	u32 len;     // number of registers (at most INT_MAX, so that result holds it)
+	u32 arg;     // argument of permission commands
+} char_batch_cmd_t;
+
+// Argument of CHAR_BATCH
+typedef struct
+{
+	u64 cmds;     // address of char_batch_cmd_t array
+	u32 count;    // number of commands (at most CHAR_BATCH_MAX_CMDS)
+	u32 flags;    // CHAR_BATCH_* flags
+	u32 done;     // returns: number of executed commands
+	u32 reserved; // must be 0
+} char_batch_t;
+
+// Dirty range returned by CHAR_GET_DIRTY
+typedef struct
+{
+	u64 offset;  // start data register
+	u64 len;     // number of registers
+} char_dirty_range_t;
+
+// Argument of CHAR_GET_DIRTY
+typedef struct
+{
+	u64 since;    // epoch returned by the previous complete query (0: all data registers)
+	u64 epoch;    // returns: epoch to pass as since to the next query (set when start is 0)
+	u64 start;    // first data register to look at (0: new query),
+	              // returns: where to resume (size of data registers: query is complete)
+	u64 ranges;   // address of char_dirty_range_t array
+	u64 data;     // address of buffer receiving data of ranges back to back (0: ranges only)
+	u64 data_len; // size of data buffer, returns: number of bytes stored in it
+	u32 count;    // capacity of ranges array, returns: number of ranges stored in it
+	u32 flags;    // must be 0
+} char_dirty_t;
+
+// Argument of CHAR_SET_EVENTFD
+typedef struct
+{
+	s32 fd;       // eventfd file descriptor
+	u32 events;   // CHAR_EVENT_* events to signal (0: unsubscribe the eventfd)
+	u64 threshold; // CHAR_EVENT_THRESHOLD: period in reads + writes
+} char_eventfd_t;
+
+// Argument of CHAR_CRC32C/CHAR_FILL/CHAR_COMPARE
+typedef struct
+{
+	u64 offset;   // start data register
+	u64 len;      // number of registers, returns: number of registers processed
+	u64 addr;     // CHAR_FILL: address of pattern, CHAR_COMPARE: address of buffer (len bytes)
+	u32 addr_len; // CHAR_FILL: size of pattern (1 to CHAR_FILL_MAX_PATTERN), otherwise 0
+	u32 crc;      // CHAR_CRC32C: CRC32C of preceding data (0: none), returns: CRC32C up to the range end
+	u64 mismatch; // CHAR_COMPARE returns: first register differing from the buffer (offset + len: none)
+} char_region_t;
+
+// Argument of CHAR_ATOMIC
+typedef struct
+{
+	u64 offset;   // data register, aligned to size
+	u64 value;    // operand (low size bytes)
+	u64 expected; // CHAR_ATOMIC_CAS: value the register must hold to be stored
+	u64 old;      // returns: value of the register before the operation
+	u32 op;       // CHAR_ATOMIC_* operation
+	u32 size;     // size of register: 1, 2, 4 or 8 bytes (host byte order)
+} char_atomic_t;
+
+// Argument of CHAR_SNAPSHOT
+typedef struct
+{
+	u32 flags;    // CHAR_SNAPSHOT_* flags
+	s32 fd;       // returns: file descriptor of the snapshot
+} char_snapshot_t;
+
+// Argument of CHAR_EXPORT_DMABUF
+typedef struct
+{
+	u64 offset;   // start data register, page aligned
+	u64 len;      // number of registers, rounded up to pages (0: until end of data registers)
+	u32 flags;    // CHAR_DMABUF_* flags
+	s32 fd;       // returns: file descriptor of the dma-buf
+} char_dmabuf_export_t;
+
+// Asynchronous read/write (CHAR_ASYNC_SUBMIT)
+typedef struct
+{
+	u64 user_data;  // returned with the completion
+	u64 offset;     // start data register
+	u64 addr;       // address of user buffer
+	u64 len;        // number of registers
+	u32 op;         // CHAR_ASYNC_READ/CHAR_ASYNC_WRITE
+	u32 reserved;   // must be 0
+} char_async_req_t;
+
+// Completion of an asynchronous read/write (CHAR_ASYNC_REAP)
+typedef struct
+{
+	u64 user_data;  // user_data of the request
+	s64 result;     // number of registers transferred, or negative error code
+	u64 latency_ns; // time from submission to completion
+} char_async_cqe_t;
+
+// Argument of CHAR_ASYNC_SUBMIT
+typedef struct
+{
+	u64 reqs;       // address of array of char_async_req_t
+	u32 nr;         // number of requests
+	u32 submitted;  // returns: number of requests submitted (stops at the first error)
+} char_async_submit_t;
+
+// Argument of CHAR_ASYNC_REAP
+typedef struct
+{
+	u64 cqes;       // address of array of char_async_cqe_t
+	u32 min_nr;     // number of completions to wait for
+	u32 max_nr;     // number of entries of the array
+	s64 timeout_ns; // maximum time to wait (0: do not wait, negative: no limit)
+	u32 reaped;     // returns: number of completions returned
+	u32 reserved;   // must be 0
+} char_async_reap_t;
+
+// Command area of an io_uring SQE (16 bytes)
+typedef struct
+{
+	u64 arg;      // ioctl argument (address of user data)
+	u64 reserved; // must be 0
+} char_uring_cmd_t;
+
+// Latency histograms of one CPU
+typedef struct
+{
+	u64 buckets[CHAR_HIST_NR_OPS][CHAR_HIST_NR_BUCKETS];
+} char_hist_t;
+
+// Character Device instance data structure (one device file each)
+typedef struct char_inst
+{
+    dev_t dev_num; 			     // device number
+	struct device *dev; 	     // device in class
+	char_dev_t *char_hw;	     // hardware device
+	int node;                    // NUMA node of hardware device buffers
+
+	struct cdev *vcdev;          // cdev structure is used to describe character device
+	atomic_t open_cnt;           // number of file open time
+	struct list_head files;      // open files of the instance
+	spinlock_t files_lock;       // protect list of open files
+
+	struct inode *inode;         // inode whose address space all opens share (set on first open)
+	struct address_space *mapping; // address space of mappings of data registers
+	struct rw_semaphore map_lock; // serialize page faults with revocation of mappings
+	struct list_head dmabufs;    // exported dma-bufs (their mappings are revoked too)
+	struct mutex dmabufs_lock;   // protect list of exported dma-bufs
+
+	wait_queue_head_t fifo_rd_wq; // readers waiting for data in FIFO mode
+	wait_queue_head_t fifo_wr_wq; // writers waiting for space in FIFO mode
+
+	char_hist_t __percpu *hist;  // latency histograms of entry points
+	struct dentry *debugfs;      // debugfs directory of the instance
+
+	struct list_head subs;       // eventfd subscribers (RCU list)
+	struct mutex subs_lock;      // serialize updates of the subscribers list
+
+	struct llist_head irq_list;  // requests which raised a simulated interrupt
+	struct work_struct irq_work;  // bottom half of simulated interrupts
+} char_inst_t;
+
+// Open file data structure (private data of a file)
+typedef struct char_file
+{
+	char_inst_t *inst;           // opened instance
+	struct list_head node;       // entry in list of open files of the instance
+	pid_t pid;                   // process which opened the file
+	char comm[TASK_COMM_LEN];    // command name of that process
+	u32 flags;                   // CHAR_FILE_* view flags
+
+	// statistics counters of the file (shared only by threads sharing the descriptor)
+	atomic64_t read_ops;
+	atomic64_t read_bytes;
+	atomic64_t write_ops;
+	atomic64_t write_bytes;
+	atomic64_t cmds;
+	atomic64_t errors;
+
+	void *staging;               // staging buffer of commands (allocated on first use)
+	struct mutex staging_lock;   // serialize users of the staging buffer
+
+	unsigned int nr_subs;        // number of eventfd subscriptions (protected by subs_lock)
+
+	// asynchronous reads/writes of the file
+	struct list_head async_inflight; // requests waiting for their interrupt
+	struct list_head async_done; // completed requests waiting to be reaped
+	unsigned int async_nr;       // number of requests of both lists
+	unsigned int async_nr_done;  // number of completed requests
+	spinlock_t async_lock;       // protect lists
+	wait_queue_head_t async_wq;  // reapers/release waiting for completions
+} char_file_t;
+
+// Eventfd subscribed to events of an instance
+typedef struct char_sub
+{
+	struct list_head node;       // entry in list of subscribers of the instance
+	struct rcu_head rcu;         // deferred release
+	char_file_t *owner;          // file which subscribed
+	struct eventfd_ctx *ctx;     // eventfd to signal
+	u32 events;                  // CHAR_EVENT_* events
+	u64 threshold;               // CHAR_EVENT_THRESHOLD period
+	atomic64_t next;             // CHAR_EVENT_THRESHOLD: next number of reads + writes to signal
+} char_sub_t;
+
+// Asynchronous read/write in flight
+typedef struct char_req
+{
+	struct hrtimer timer;        // completion time in the timing model (simulated interrupt)
+	struct llist_node irq_node;  // entry in list of raised interrupts of the instance
+	struct list_head node;       // entry in list of requests in flight, then completed, of the file
+	char_inst_t *inst;           // instance of the file
+	char_file_t *owner;          // file which submitted the request
+	struct mm_struct *mm;        // address space of the submitter (user buffer)
+	u64 user_data;               // user_data of the request
+	u64 offset;                  // first data register
+	u64 addr;                    // user buffer
+	u64 len;                     // number of registers
+	bool write;                  // CHAR_ASYNC_WRITE
+	s64 result;                  // number of registers transferred, or negative error code
+	u64 submit_ns;               // submission time
+	u64 done_ns;                 // completion time, when the bottom half ran
+} char_req_t;
+
+// Exported dma-buf of data registers
+typedef struct
+{
+	char_inst_t *inst;           // exporting instance
+	pgoff_t pgoff;               // first page of data registers
+	unsigned long nr_pages;      // number of pages
+	bool writable;               // CHAR_DMABUF_WRITE
+	struct inode *inode;         // inode of the dma-buf file, whose address space holds its mappings
+	struct list_head node;       // entry in list of exported dma-bufs of the instance
+	struct list_head attachments; // attachments of importing devices
+	struct mutex lock;           // protect list of attachments
+} char_dmabuf_t;
+
+// Attachment of a device importing a dma-buf
+typedef struct
+{
+	struct device *dev;          // importing device
+	struct sg_table sgt;         // pages of the dma-buf
+	struct list_head node;       // entry in list of attachments of the dma-buf
+	bool mapped;                 // sgt is mapped for the device
+} char_dmabuf_attach_t;
+
+// Character Driver data structure
+struct _char_drv
+{
+    dev_t dev_num; 			     // first device number
+	struct class *dev_class;     // class contains devices
+	unsigned int num_insts;      // number of device instances
+	char_inst_t *insts;          // device instances
+	struct dentry *debugfs;      // debugfs directory of the driver
+} char_drv;
+
+
+
+
+/******************************** OS SPECIFIC - START *******************************/
+
+/* Functions: Measure latency of an operation in its histogram (op: CHAR_OP_* or CHAR_HIST_*)
+	(only while histograms or tracepoints are enabled, start_ns is 0 otherwise)
+*/
+static inline u64 char_driver_op_start(void)
+{
+	if(static_branch_unlikely(&char_hist_key) || trace_char_io_enabled() || trace_char_cmd_enabled())
+		return ktime_get_ns();
+	return 0;
+}
+
+static inline u64 char_driver_op_latency(u64 start_ns)
+{
+	return start_ns ? ktime_get_ns() - start_ns : 0;
+}
+
+static u64 char_driver_op_end(char_inst_t *inst, unsigned int op, u64 start_ns)
+{
+	u64 latency_ns = char_driver_op_latency(start_ns);
+
+	if(start_ns && static_branch_unlikely(&char_hist_key))
+		this_cpu_inc(inst->hist->buckets[op][min_t(unsigned int, fls64(latency_ns), CHAR_HIST_NR_BUCKETS - 1)]);
+	return latency_ns;
+}
+
+/* Function: Finish a read/write/mmap operation (histogram and tracepoint) */
+static void char_driver_trace_io(char_inst_t *inst, unsigned int op, loff_t offset, size_t len, ssize_t result, u64 start_ns)
+{
+	u64 latency_ns = char_driver_op_end(inst, op, start_ns);
+
+	trace_char_io(MINOR(inst->dev_num), op, offset, len, result, latency_ns);
+}
+
+/* Function: Account a finished read/write in statistics counters of the file */
+static void char_file_count_io(char_file_t *cf, bool write, ssize_t result)
+{
+	if(result < 0)
+		atomic64_inc(&cf->errors);
+	else if(write)
+	{
+		atomic64_inc(&cf->write_ops);
+		atomic64_add(result, &cf->write_bytes);
+	}
+	else
+	{
+		atomic64_inc(&cf->read_ops);
+		atomic64_add(result, &cf->read_bytes);
+	}
+}
+
+/* Function: Data registers of the file work as a FIFO (device in FIFO mode, file not raw) */
+static inline bool char_file_fifo_mode(char_file_t *cf)
+{
+	return !(READ_ONCE(cf->flags) & CHAR_FILE_RAW) && char_hw_fifo_mode(cf->inst->char_hw);
+}
+
+/* Function: Set and clear flags of a mapping (vm_flags is read-only from 6.3) */
+static inline void char_vma_mod_flags(struct vm_area_struct *vma, vm_flags_t set, vm_flags_t clear)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+	vm_flags_mod(vma, set, clear);
+#else
+	vma->vm_flags = (vma->vm_flags | set) & ~clear;
+#endif
+}
+
+/* Function: Check the permission bits of CONTROL_ACCESS_REG against protections of a mapping
+	Parameters:
+		vm_flags: VM_READ/VM_WRITE protections of the mapping
+*/
+static int char_driver_vm_perm(char_dev_t *hw, unsigned long vm_flags)
+{
+	unsigned char ctrl = READ_ONCE(hw->control_regs[CONTROL_ACCESS_REG]);
+
+	if((vm_flags & VM_READ) && (ctrl & CTRL_READ_DATA_BIT) == DISABLE)
+		return -EACCES;
+	if((vm_flags & VM_WRITE) && (ctrl & CTRL_WRITE_DATA_BIT) == DISABLE)
+		return -EACCES;
+	return 0;
+}
+
+/* Function: Apply permission bits of CONTROL_ACCESS_REG to a mapping of data registers */
+static int char_driver_mmap_perm(char_dev_t *hw, struct vm_area_struct *vma)
+{
+	unsigned char ctrl = READ_ONCE(hw->control_regs[CONTROL_ACCESS_REG]);
+	vm_flags_t clear = 0;
+	int ret;
+
+	ret = char_driver_vm_perm(hw, vma->vm_flags);
+	if(ret < 0)
+		return ret;
+
+	// do not allow mprotect() to grant what the control register denies
+	if((ctrl & CTRL_READ_DATA_BIT) == DISABLE)
+		clear |= VM_MAYREAD;
+	if((ctrl & CTRL_WRITE_DATA_BIT) == DISABLE)
+		clear |= VM_MAYWRITE;
+	char_vma_mod_flags(vma, 0, clear);
+	return 0;
+}
+
+/* Function: Zap all mappings of data registers after a permission has been disabled
+	(they fault in again through char_driver_vm_fault, which checks the permission)
+*/
+static void char_driver_revoke_maps(char_inst_t *inst)
+{
+	struct address_space *mapping;
+	char_dmabuf_t *db;
+
+	spin_lock(&inst->files_lock);
+	mapping = inst->mapping;
+	spin_unlock(&inst->files_lock);
+	if(!mapping) // never opened, so never mapped (nor exported)
+		return;
+
+	down_write(&inst->map_lock);
+	unmap_mapping_range(mapping, 0, 0, 0); // private copies-on-write are not device data
+
+	// mappings of exported dma-bufs live in the address spaces of their own files
+		// (importing devices keep their DMA mappings, see CHAR_EXPORT_DMABUF)
+	mutex_lock(&inst->dmabufs_lock);
+	list_for_each_entry(db, &inst->dmabufs, node)
+		unmap_mapping_range(db->inode->i_mapping, 0, 0, 0);
+	mutex_unlock(&inst->dmabufs_lock);
+	up_write(&inst->map_lock);
+}
+
+/* Function: Copy a user buffer into the staging buffer of the file
+   Parameters:
+		* cf: pointer to open file
+		* ubuf: address of user buffer
+		* size: size of user buffer
+   Return: staging buffer (or a new buffer if the staging buffer is busy or too small),
+		   or ERR_PTR() of negative error code; release it with char_file_unstage()
+*/
+static void *char_file_stage(char_file_t *cf, const void __user *ubuf, size_t size)
+{
+	// another thread sharing the descriptor uses the staging buffer
+	if(size > CHAR_FILE_STAGING_SIZE || !mutex_trylock(&cf->staging_lock))
+		return memdup_user(ubuf, size);
+
+	if(!cf->staging)
+	{
+		cf->staging = kmalloc(CHAR_FILE_STAGING_SIZE, GFP_KERNEL);
+		if(!cf->staging)
+		{
+			mutex_unlock(&cf->staging_lock);
+			return ERR_PTR(-ENOMEM);
+		}
+	}
+
+	if(copy_from_user(cf->staging, ubuf, size))
+	{
+		mutex_unlock(&cf->staging_lock);
+		return ERR_PTR(-EFAULT);
+	}
+	return cf->staging;
+}
+
+static void char_file_unstage(char_file_t *cf, void *buf)
+{
+	if(buf == cf->staging)
+		mutex_unlock(&cf->staging_lock);
+	else
+		kfree(buf);
+}
+
+/* Function: Get a buffer for data following a staged user buffer
+   Parameters:
+		* staged: buffer returned by char_file_stage()
+		* staged_size: size of the staged user buffer
+		* size: size of data
+   Return: rest of the staging buffer (or a new buffer if it was not staged there or is too small),
+		   or ERR_PTR() of negative error code; release it with char_file_unstage_data()
+*/
+static void *char_file_stage_data(char_file_t *cf, void *staged, size_t staged_size, size_t size)
+{
+	void *data;
+
+	if(staged == cf->staging && size <= CHAR_FILE_STAGING_SIZE - staged_size)
+		return staged + staged_size;
+
+	data = kvmalloc(size, GFP_KERNEL);
+	return data ? data : ERR_PTR(-ENOMEM);
+}
+
+static void char_file_unstage_data(char_file_t *cf, void *staged, size_t staged_size, void *data)
+{
+	if(staged != cf->staging || data != staged + staged_size)
+		kvfree(data);
+}
+
+/* Function: Signal the eventfd of a subscriber */
+static inline void char_sub_signal(char_sub_t *sub)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 8, 0)
+	eventfd_signal(sub->ctx);
+#else
+	eventfd_signal(sub->ctx, 1);
+#endif
+}
+
+/* Function: Next multiple of the threshold of a subscriber after a number of reads + writes */
+static inline u64 char_sub_next(char_sub_t *sub, u64 ops)
+{
+	return (div64_u64(ops, sub->threshold) + 1) * sub->threshold;
+}
+
+/* Function: Number of reads + writes of the device */
+static u64 char_driver_count_ops(char_dev_t *hw)
+{
+	char_stats_t stats;
+
+	char_hw_get_stats(hw, &stats);
+	return stats.read_ops + stats.write_ops;
+}
+
+/* Function: Notifier of the register model, signal subscribers of the events
+   Note: runs in the context of the operation which caused the events, with device locks held
+*/
+static void char_driver_notify(char_dev_t *hw, unsigned int hw_events)
+{
+	char_inst_t *inst = hw->notify_data;
+	char_sub_t *sub;
+	u32 events = 0;
+	u64 ops = 0;
+	s64 next;
+
+	if(hw_events & CHAR_HW_EV_CONTROL)
+		events |= CHAR_EVENT_PERM;
+	if(hw_events & CHAR_HW_EV_OVERFLOW)
+		events |= CHAR_EVENT_OVERFLOW;
+	if(hw_events & CHAR_HW_EV_CLEAR)
+		events |= CHAR_EVENT_CLEAR;
+	if(hw_events & CHAR_HW_EV_COUNT)
+		ops = char_driver_count_ops(hw);
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(sub, &inst->subs, node)
+	{
+		bool signal = sub->events & events;
+
+		// the count crossed the next multiple of threshold: the first CPU to see it signals
+		if((hw_events & CHAR_HW_EV_COUNT) && (sub->events & CHAR_EVENT_THRESHOLD))
+		{
+			next = atomic64_read(&sub->next);
+			if(ops >= next && atomic64_cmpxchg(&sub->next, next, char_sub_next(sub, ops)) == next)
+				signal = true;
+		}
+
+		if(signal)
+			char_sub_signal(sub);
+	}
+	rcu_read_unlock();
+}
+
+/* Function: Ask the register model for the events of all subscribers (subs_lock held) */
+static void char_driver_update_events(char_inst_t *inst)
+{
+	unsigned int hw_events = 0;
+	char_sub_t *sub;
+
+	list_for_each_entry(sub, &inst->subs, node)
+	{
+		if(sub->events & CHAR_EVENT_PERM)
+			hw_events |= CHAR_HW_EV_CONTROL;
+		if(sub->events & CHAR_EVENT_OVERFLOW)
+			hw_events |= CHAR_HW_EV_OVERFLOW;
+		if(sub->events & CHAR_EVENT_CLEAR)
+			hw_events |= CHAR_HW_EV_CLEAR;
+		if(sub->events & CHAR_EVENT_THRESHOLD)
+			hw_events |= CHAR_HW_EV_COUNT;
+	}
+	char_hw_set_notify_events(inst->char_hw, hw_events);
+}
+
+/* Functions: Release a subscriber once notifiers walking the list are done with it */
+static void char_sub_free(struct rcu_head *rcu)
+{
+	char_sub_t *sub = container_of(rcu, char_sub_t, rcu);
+
+	eventfd_ctx_put(sub->ctx);
+	kfree(sub);
+}
+
+static void char_sub_del(char_sub_t *sub)
+{
+	list_del_rcu(&sub->node);
+	sub->owner->nr_subs--;
+	call_rcu(&sub->rcu, char_sub_free);
+}
+
+/* Function: Subscribe an eventfd to events of the device, or unsubscribe it */
+static long char_driver_set_eventfd(char_file_t *cf, char_eventfd_t __user *uevfd)
+{
+	char_inst_t *inst = cf->inst;
+	char_sub_t *sub, *new_sub = NULL;
+	struct eventfd_ctx *ctx;
+	char_eventfd_t evfd;
+	long ret = -ENOENT;
+
+	if(copy_from_user(&evfd, uevfd, sizeof(evfd)))
+		return -EFAULT;
+	if(evfd.events & ~CHAR_EVENTS)
+		return -EINVAL;
+	if((evfd.events & CHAR_EVENT_THRESHOLD) && evfd.threshold == 0)
+		return -EINVAL;
+
+	ctx = eventfd_ctx_fdget(evfd.fd);
+	if(IS_ERR(ctx))
+		return PTR_ERR(ctx);
+
+	if(evfd.events)
+	{
+		new_sub = kzalloc(sizeof(*new_sub), GFP_KERNEL);
+		if(!new_sub)
+		{
+			eventfd_ctx_put(ctx);
+			return -ENOMEM;
+		}
+		new_sub->owner = cf;
+		new_sub->ctx = ctx;
+		new_sub->events = evfd.events;
+		new_sub->threshold = evfd.threshold;
+		if(evfd.events & CHAR_EVENT_THRESHOLD)
+			atomic64_set(&new_sub->next, char_sub_next(new_sub, char_driver_count_ops(inst->char_hw)));
+	}
+
+	mutex_lock(&inst->subs_lock);
+
+	// a new registration of the eventfd replaces the previous one
+	list_for_each_entry(sub, &inst->subs, node)
+	{
+		if(sub->owner == cf && sub->ctx == ctx)
+		{
+			char_sub_del(sub);
+			ret = 0;
+			break;
+		}
+	}
+
+	if(new_sub)
+	{
+		if(cf->nr_subs < CHAR_FILE_MAX_EVENTFDS)
+		{
+			list_add_tail_rcu(&new_sub->node, &inst->subs);
+			cf->nr_subs++;
+			new_sub = NULL;
+			ret = 0;
+		}
+		else
+			ret = -ENOSPC;
+	}
+
+	char_driver_update_events(inst);
+	mutex_unlock(&inst->subs_lock);
+
+	// the reference of ctx went to the new subscriber, unless there is none
+	if(!evfd.events || new_sub)
+		eventfd_ctx_put(ctx);
+	kfree(new_sub);
+	return ret;
+}
+
+/* Function: Free a completed request (its interrupt handler may still be returning) */
+static void char_req_free(char_req_t *req)
+{
+	hrtimer_cancel(&req->timer);
+	mmdrop(req->mm);
+	kfree(req);
+}
+
+static bool char_file_async_idle(char_file_t *cf)
+{
+	bool idle;
+
+	spin_lock(&cf->async_lock);
+	idle = list_empty(&cf->async_inflight);
+	spin_unlock(&cf->async_lock);
+	return idle;
+}
+
+/* Function: Cancel asynchronous reads/writes of a file being released */
+static void char_file_async_release(char_file_t *cf)
+{
+	char_req_t *req, *tmp;
+	LIST_HEAD(cancelled);
+
+	// Requests whose interrupt is not raised yet never complete (nor transfer data)
+	spin_lock(&cf->async_lock);
+	list_for_each_entry_safe(req, tmp, &cf->async_inflight, node)
+	{
+		if(hrtimer_try_to_cancel(&req->timer) == 1)
+		{
+			list_move(&req->node, &cancelled);
+			cf->async_nr--;
+		}
+	}
+	spin_unlock(&cf->async_lock);
+
+	// the others raised it already, wait for the bottom half
+	wait_event(cf->async_wq, char_file_async_idle(cf));
+
+	list_splice(&cancelled, &cf->async_done);
+	list_for_each_entry_safe(req, tmp, &cf->async_done, node)
+		char_req_free(req);
+}
+
+/* Functions: Entry points */
+static int char_driver_open(struct inode *inode, struct file *filp)
+{
+	char_inst_t *inst = &char_drv.insts[MINOR(inode->i_rdev) - MINOR(char_drv.dev_num)];
+	u64 start_ns = char_driver_op_start();
+	char_file_t *cf;
+
+	cf = kzalloc(sizeof(*cf), GFP_KERNEL);
+	if(!cf)
+		return -ENOMEM;
+	cf->inst = inst;
+	cf->pid = task_tgid_nr(current);
+	get_task_comm(cf->comm, current);
+	mutex_init(&cf->staging_lock);
+	INIT_LIST_HEAD(&cf->async_inflight);
+	INIT_LIST_HEAD(&cf->async_done);
+	spin_lock_init(&cf->async_lock);
+	init_waitqueue_head(&cf->async_wq);
+
+	spin_lock(&inst->files_lock);
+	list_add_tail(&cf->node, &inst->files);
+	// every device node of the instance maps through the same address space,
+		// so that revoking a permission can zap all mappings at once
+	if(!inst->mapping)
+	{
+		inst->inode = igrab(inode);
+		inst->mapping = inode->i_mapping;
+	}
+	spin_unlock(&inst->files_lock);
+	filp->f_mapping = inst->mapping;
+
+	filp->private_data = cf; // entry points work on the open file
+	trace_char_open(MINOR(inst->dev_num), atomic_inc_return(&inst->open_cnt)); // increase file open time
+	char_driver_op_end(inst, CHAR_HIST_OPEN, start_ns);
+	return 0;
+}
+
+static int char_driver_release(struct inode *inode, struct file *filp)
+{
+	char_file_t *cf = filp->private_data;
+	char_inst_t *inst = cf->inst;
+	u64 start_ns = char_driver_op_start();
+
+	spin_lock(&inst->files_lock);
+	list_del(&cf->node);
+	spin_unlock(&inst->files_lock);
+
+	// end eventfd subscriptions of the file
+	if(cf->nr_subs)
+	{
+		char_sub_t *sub, *tmp;
+
+		mutex_lock(&inst->subs_lock);
+		list_for_each_entry_safe(sub, tmp, &inst->subs, node)
+		{
+			if(sub->owner == cf)
+				char_sub_del(sub);
+		}
+		char_driver_update_events(inst);
+		mutex_unlock(&inst->subs_lock);
+	}
+
+	char_file_async_release(cf);
+	kfree(cf->staging);
+	kfree(cf);
+
+	trace_char_release(MINOR(inst->dev_num), atomic_read(&inst->open_cnt));
+	char_driver_op_end(inst, CHAR_HIST_RELEASE, start_ns);
+	return 0;
+}
+
+/* Function: Wake FIFO readers and writers (data/space, or a switch of mode/permission) */
+static void char_driver_wake_fifo(char_inst_t *inst)
+{
+	wake_up_interruptible_poll(&inst->fifo_rd_wq, EPOLLIN | EPOLLRDNORM);
+	wake_up_interruptible_poll(&inst->fifo_wr_wq, EPOLLOUT | EPOLLWRNORM);
+}
+
+/* Function: Consume data from the FIFO, wait for data unless nonblock is set */
+static ssize_t char_driver_fifo_read(char_inst_t *inst, struct iov_iter *to, bool nonblock)
+{
+	char_dev_t *hw = inst->char_hw;
+	unsigned char *regs = NULL;
+	ssize_t num_bytes;
+	size_t copied, total = 0;
+
+	while(iov_iter_count(to))
+	{
+		num_bytes = char_hw_fifo_read_begin(hw, iov_iter_count(to), &regs);
+		if(num_bytes < 0)
+			return total ? total : num_bytes;
+
+		if(num_bytes == 0)
+		{
+			// FIFO is empty: return what has been read, or wait for writers
+				// (or for a switch of mode/permission, which the next begin reports)
+			if(total)
+				break;
+			if(nonblock)
+				return -EAGAIN;
+			if(wait_event_interruptible(inst->fifo_rd_wq, char_hw_fifo_readable(hw)))
+				return -ERESTARTSYS;
+			continue;
+		}
+
+		// copy data from FIFO directly to user buffers
+		copied = copy_to_iter(regs, num_bytes, to);
+		char_hw_fifo_read_end(hw, copied ? (ssize_t)copied : -EFAULT);
+		if(copied == 0)
+			return total ? total : -EFAULT;
+
+		total += copied;
+		wake_up_interruptible_poll(&inst->fifo_wr_wq, EPOLLOUT | EPOLLWRNORM);
+		if(copied < num_bytes)
+			break;
+	}
+
+	return total;
+}
+
+/* Function: Append data to the FIFO, wait for space unless nonblock is set */
+static ssize_t char_driver_fifo_write(char_inst_t *inst, struct iov_iter *from, bool nonblock)
+{
+	char_dev_t *hw = inst->char_hw;
+	unsigned char *regs = NULL;
+	ssize_t num_bytes;
+	size_t copied, total = 0;
+
+	while(iov_iter_count(from))
+	{
+		num_bytes = char_hw_fifo_write_begin(hw, iov_iter_count(from), &regs);
+		if(num_bytes < 0)
+			return total ? total : num_bytes;
+
+		if(num_bytes == 0)
+		{
+			// FIFO is full: return what has been written, or wait for readers
+				// (or for a switch of mode/permission, which the next begin reports)
+			if(total)
+				break;
+			if(nonblock)
+				return -EAGAIN;
+			if(wait_event_interruptible(inst->fifo_wr_wq, char_hw_fifo_writable(hw)))
+				return -ERESTARTSYS;
+			continue;
+		}
+
+		// copy data from user buffers directly to FIFO
+		copied = copy_from_iter(regs, num_bytes, from);
+		char_hw_fifo_write_end(hw, copied ? (ssize_t)copied : -EFAULT);
+		if(copied == 0)
+			return total ? total : -EFAULT;
+
+		total += copied;
+		wake_up_interruptible_poll(&inst->fifo_rd_wq, EPOLLIN | EPOLLRDNORM);
+		if(copied < num_bytes)
+			break;
+	}
+
+	return total;
+}
+
+/*
+	Read/write entry points work on iov_iter, so read()/write() and readv()/writev()
+	share one path: all segments of a vector are moved by one device operation.
+	They only use the position given in the kiocb, so pread()/pwrite() leave
+	the shared file position alone and threads can share one file descriptor.
+	splice()/sendfile()/copy_file_range() go through the same entry points with
+	iov_iters over pipe pages: data moves between pipes and data registers in one copy,
+	without user buffers (pages of live data registers are not lent to pipes,
+	later writes would change data already in the pipe).
+*/
+
+/* Function: Move data from a file into a pipe by copying through read_iter */
+static ssize_t char_driver_copy_splice_read(struct file *filp, loff_t *ppos, struct pipe_inode_info *pipe,
+                                            size_t len, unsigned int flags)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 5, 0)
+	return copy_splice_read(filp, ppos, pipe, len, flags);
+#else
+	return generic_file_splice_read(filp, ppos, pipe, len, flags);
+#endif
+}
+
+/* Function: Move the position of a file, data registers by offset only */
+static loff_t char_driver_llseek(struct file *filp, loff_t off, int whence)
+{
+	char_file_t *cf = filp->private_data;
+	char_inst_t *inst = cf->inst;
+
+	// A FIFO has no position
+	if(char_file_fifo_mode(cf))
+		return -ESPIPE;
+
+	// SEEK_SET/SEEK_CUR/SEEK_END inside [0, size of data registers]
+	return fixed_size_llseek(filp, off, whence, inst->char_hw->data_size);
+}
+
+/* Function: Read data registers at the position of the kiocb */
+static ssize_t char_driver_data_read(char_inst_t *inst, struct kiocb *iocb, struct iov_iter *to)
+{
+	char_dev_t *hw = inst->char_hw;
+	unsigned char *regs = NULL;
+	ssize_t avail;
+	size_t copied;
+
+	// locate data in char device buffer
+	avail = char_hw_read_begin(hw, iocb->ki_pos, iov_iter_count(to), &regs);
+	if(avail < 0)
+		return avail;
+
+	// copy data from char device buffer directly to user buffers
+		// (a partial copy is reported as a short read, nothing copied as a fault)
+	copied = copy_to_iter(regs, avail, to);
+	if(avail && copied == 0)
+	{
+		char_hw_read_end(hw, iocb->ki_pos, avail, -EFAULT);
+		return -EFAULT;
+	}
+	char_hw_read_end(hw, iocb->ki_pos, avail, copied);
+
+	iocb->ki_pos += copied; // update offset value
+	return copied;          // return read byte number
+}
+
+/* Function: Write data registers at the position of the kiocb */
+static ssize_t char_driver_data_write(char_inst_t *inst, struct kiocb *iocb, struct iov_iter *from)
+{
+	char_dev_t *hw = inst->char_hw;
+	unsigned char *regs = NULL;
+	ssize_t avail;
+	size_t copied;
+
+	// locate data in char device buffer
+	avail = char_hw_write_begin(hw, iocb->ki_pos, iov_iter_count(from), &regs);
+	if(avail < 0)
+		return avail;
+
+	// copy data from user buffers directly to char device buffer
+		// (a partial copy is reported as a short write, nothing copied as a fault)
+	copied = copy_from_iter(regs, avail, from);
+	if(avail && copied == 0)
+	{
+		char_hw_write_end(hw, iocb->ki_pos, avail, -EFAULT);
+		return -EFAULT;
+	}
+	char_hw_write_end(hw, iocb->ki_pos, avail, copied);
+
+	iocb->ki_pos += copied; // update offset value
+	return copied;          // return write byte number
+}
+
+static ssize_t char_driver_read_iter(struct kiocb *iocb, struct iov_iter *to)
+{
+	struct file *filp = iocb->ki_filp;
+	char_file_t *cf = filp->private_data;
+	char_inst_t *inst = cf->inst;
+	u64 start_ns = char_driver_op_start();
+	loff_t pos = iocb->ki_pos;
+	size_t len = iov_iter_count(to);
+	ssize_t ret;
+
+	if(char_file_fifo_mode(cf))
+	{
+		ret = char_driver_fifo_read(inst, to, (filp->f_flags & O_NONBLOCK) || (iocb->ki_flags & IOCB_NOWAIT));
+		// -ENOTCONN: switched to offset mode before anything was read
+		if(ret != -ENOTCONN)
+		{
+			char_file_count_io(cf, false, ret);
+			char_driver_trace_io(inst, CHAR_OP_FIFO_READ, 0, len, ret, start_ns);
+			return ret;
+		}
+	}
+
+	ret = char_driver_data_read(inst, iocb, to);
+	char_file_count_io(cf, false, ret);
+	char_driver_trace_io(inst, CHAR_OP_READ, pos, len, ret, start_ns);
+	return ret;
+}
+
+static ssize_t char_driver_write_iter(struct kiocb *iocb, struct iov_iter *from)
+{
+	struct file *filp = iocb->ki_filp;
+	char_file_t *cf = filp->private_data;
+	char_inst_t *inst = cf->inst;
+	u64 start_ns = char_driver_op_start();
+	loff_t pos = iocb->ki_pos;
+	size_t len = iov_iter_count(from);
+	ssize_t ret;
+
+	if(char_file_fifo_mode(cf))
+	{
+		ret = char_driver_fifo_write(inst, from, (filp->f_flags & O_NONBLOCK) || (iocb->ki_flags & IOCB_NOWAIT));
+		// -ENOTCONN: switched to offset mode before anything was written
+		if(ret != -ENOTCONN)
+		{
+			char_file_count_io(cf, true, ret);
+			char_driver_trace_io(inst, CHAR_OP_FIFO_WRITE, 0, len, ret, start_ns);
+			return ret;
+		}
+	}
+
+	ret = char_driver_data_write(inst, iocb, from);
+	char_file_count_io(cf, true, ret);
+	char_driver_trace_io(inst, CHAR_OP_WRITE, pos, len, ret, start_ns);
+	return ret;
+}
+
+/* Function: Copy a range of data registers from/to a user buffer
+   Return: number of registers copied, or negative error code
+*/
+static ssize_t char_driver_copy_range(char_dev_t *hw, loff_t offset, size_t len, void __user *ubuf, bool write)
+{
+	unsigned char *regs;
+	unsigned long not_copied;
+	ssize_t avail, ret;
+
+	if(write)
+	{
+		avail = char_hw_write_begin(hw, offset, len, &regs);
+		if(avail < 0)
+			return avail;
+		not_copied = copy_from_user(regs, ubuf, avail);
+	}
+	else
+	{
+		avail = char_hw_read_begin(hw, offset, len, &regs);
+		if(avail < 0)
+			return avail;
+		not_copied = copy_to_user(ubuf, regs, avail);
+	}
+
+	// a partial copy is reported as a short transfer, nothing copied as a fault
+	ret = avail - not_copied;
+	if(not_copied && ret == 0)
+		ret = -EFAULT;
+
+	if(write)
+		char_hw_write_end(hw, offset, avail, ret);
+	else
+		char_hw_read_end(hw, offset, avail, ret);
+	return ret;
+}
+
+/* Function: Read/write a range of data registers from/to a user buffer */
+static long char_driver_rw_range(char_inst_t *inst, char_range_t __user *urange, bool write)
+{
+	char_range_t range;
+
+	if(copy_from_user(&range, urange, sizeof(range)))
+		return -EFAULT;
+	if(range.flags || range.offset > LLONG_MAX)
+		return -EINVAL;
+
+	return char_driver_copy_range(inst->char_hw, range.offset, range.len, u64_to_user_ptr(range.addr), write);
+}
+
+/* Function: Number of bytes of kernel data of a command of a batch
+	(payload of a write, result of a read or status, only registers which exist)
+*/
+static size_t char_batch_data_len(char_dev_t *hw, const char_batch_cmd_t *cmd)
+{
+	switch(cmd->op)
+	{
+		case CHAR_BATCH_GET_STS_REGS:
+			return sizeof(sts_regs_t);
+		case CHAR_BATCH_READ_RANGE:
+		case CHAR_BATCH_WRITE_RANGE:
+			if(cmd->len > INT_MAX || cmd->offset >= hw->data_size)
+				return 0;
+			return min_t(size_t, cmd->len, hw->data_size - cmd->offset);
+		default:
+			return 0;
+	}
+}
+
+/* Function: Execute one command of a batch, the device is locked (kernel data only)
+   Parameters:
+		* data: kernel data of the command (see char_batch_data_len)
+		* len: bytes of a write payload copied from the user buffer, or negative error code
+*/
+static s32 char_driver_batch_one(char_inst_t *inst, char_batch_cmd_t *cmd, unsigned char *data, s32 len)
+{
+	char_dev_t *hw = inst->char_hw;
+	unsigned char *regs;
+	ssize_t avail;
+
+	switch(cmd->op)
+	{
+		case CHAR_BATCH_CLR_DATA_REGS:
+			return __char_hw_clear_data(hw);
+		case CHAR_BATCH_SET_RD_DATA_REGS:
+			__char_hw_enable_read(hw, cmd->arg);
+			return 0;
+		case CHAR_BATCH_SET_WR_DATA_REGS:
+			__char_hw_enable_write(hw, cmd->arg);
+			return 0;
+		case CHAR_BATCH_GET_STS_REGS:
+			char_hw_get_status(hw, (sts_regs_t *)data);
+			return 0;
+		case CHAR_BATCH_READ_RANGE:
+			if(cmd->offset > LLONG_MAX || cmd->len > INT_MAX)
+				return -EINVAL;
+			avail = __char_hw_read_begin(hw, cmd->offset, cmd->len, &regs);
+			if(avail < 0)
+				return avail;
+			memcpy(data, regs, avail);
+			__char_hw_read_end(hw, avail);
+			return avail;
+		case CHAR_BATCH_WRITE_RANGE:
+			if(cmd->offset > LLONG_MAX || cmd->len > INT_MAX)
+				return -EINVAL;
+			if(len < 0)
+				return len;
+			// a partial copy of the payload is a short write
+			avail = __char_hw_write_begin(hw, cmd->offset, len, &regs);
+			if(avail < 0)
+				return avail;
+			memcpy(regs, data, avail);
+			__char_hw_write_end(hw, avail);
+			return avail;
+		default:
+			return -EINVAL;
+	}
+}
+
+/* Function: Execute a batch of commands in order, atomically relative to other callers
+	(user buffers are copied before locking the device and after unlocking it,
+	a page fault never runs with the device locked)
+*/
+static long char_driver_batch(char_file_t *cf, char_batch_t __user *ubatch)
+{
+	char_inst_t *inst = cf->inst;
+	char_dev_t *hw = inst->char_hw;
+	char_batch_t batch;
+	char_batch_cmd_t *cmds;
+	s32 lens[CHAR_BATCH_MAX_CMDS];
+	unsigned char *data, *pos;
+	size_t cmds_size, data_size = 0;
+	bool revoke = false;
+	long ret = 0;
+	u32 i;
+
+	if(copy_from_user(&batch, ubatch, sizeof(batch)))
+		return -EFAULT;
+	if(batch.reserved || (batch.flags & ~CHAR_BATCH_STOP_ON_ERROR))
+		return -EINVAL;
+	if(batch.count == 0 || batch.count > CHAR_BATCH_MAX_CMDS)
+		return -EINVAL;
+
+	cmds_size = batch.count * sizeof(*cmds);
+	cmds = char_file_stage(cf, u64_to_user_ptr(batch.cmds), cmds_size);
+	if(IS_ERR(cmds))
+		return PTR_ERR(cmds);
+
+	// Kernel data of all commands follows the commands in the staging buffer
+		// (bounded, the caller does not choose the size of a kernel allocation)
+	for(i = 0; i < batch.count; i++)
+		data_size += char_batch_data_len(hw, &cmds[i]);
+	if(data_size > CHAR_BATCH_MAX_DATA)
+	{
+		ret = -E2BIG;
+		goto out_unstage;
+	}
+	data = char_file_stage_data(cf, cmds, cmds_size, data_size);
+	if(IS_ERR(data))
+	{
+		ret = PTR_ERR(data);
+		goto out_unstage;
+	}
+
+	// Copy write payloads in
+	for(i = 0, pos = data; i < batch.count; i++)
+	{
+		lens[i] = char_batch_data_len(hw, &cmds[i]);
+		if(cmds[i].op == CHAR_BATCH_WRITE_RANGE && lens[i])
+		{
+			lens[i] -= copy_from_user(pos, u64_to_user_ptr(cmds[i].addr), lens[i]);
+			if(lens[i] == 0)
+				lens[i] = -EFAULT;
+		}
+		pos += char_batch_data_len(hw, &cmds[i]);
+	}
+
+	// No other read/write/control command runs in between commands of the batch
+	char_hw_lock_device(hw);
+	for(i = 0, pos = data; i < batch.count; i++)
+	{
+		cmds[i].result = char_driver_batch_one(inst, &cmds[i], pos, lens[i]);
+		pos += char_batch_data_len(hw, &cmds[i]);
+		if((cmds[i].op == CHAR_BATCH_SET_RD_DATA_REGS || cmds[i].op == CHAR_BATCH_SET_WR_DATA_REGS) &&
+		   cmds[i].arg != ENABLE)
+			revoke = true;
+		if(cmds[i].result < 0 && (batch.flags & CHAR_BATCH_STOP_ON_ERROR))
+		{
+			i++;
+			break;
+		}
+	}
+	char_hw_unlock_device(hw);
+	batch.done = i;
+
+	// zap mappings once unlocked
+	if(revoke)
+		char_driver_revoke_maps(inst);
+
+	// a clear empties the FIFO, permissions may have changed
+	char_driver_wake_fifo(inst);
+
+	// Copy read data and status out (a fault shortens the result, registers were read anyway)
+	for(i = 0, pos = data; i < batch.done; i++)
+	{
+		void __user *ubuf = u64_to_user_ptr(cmds[i].addr);
+		unsigned long not_copied = 0;
+
+		if(cmds[i].op == CHAR_BATCH_GET_STS_REGS)
+			not_copied = copy_to_user(ubuf, pos, sizeof(sts_regs_t));
+		else if(cmds[i].op == CHAR_BATCH_READ_RANGE && cmds[i].result > 0)
+			not_copied = copy_to_user(ubuf, pos, cmds[i].result);
+		if(not_copied)
+		{
+			cmds[i].result -= not_copied;
+			if(cmds[i].result <= 0)
+				cmds[i].result = -EFAULT;
+		}
+		pos += char_batch_data_len(hw, &cmds[i]);
+	}
+
+	// return per-command results
+	if(copy_to_user(u64_to_user_ptr(batch.cmds), cmds, batch.done * sizeof(*cmds)) ||
+	   put_user(batch.done, &ubatch->done))
+		ret = -EFAULT;
+
+	char_file_unstage_data(cf, cmds, cmds_size, data);
+out_unstage:
+	char_file_unstage(cf, cmds);
+	return ret;
+}
+
+/* Function: Return ranges (and data) of data registers written since an epoch */
+static long char_driver_get_dirty(char_inst_t *inst, char_dirty_t __user *udirty)
+{
+	char_dev_t *hw = inst->char_hw;
+	char_dirty_range_t __user *uranges;
+	char_dirty_range_t range;
+	char_dirty_t dirty;
+	unsigned char *regs;
+	size_t num_regs;
+	u64 copied = 0;
+	loff_t pos;
+	u32 count = 0;
+	long ret = 0;
+
+	if(copy_from_user(&dirty, udirty, sizeof(dirty)))
+		return -EFAULT;
+	if(dirty.flags || dirty.start > hw->data_size)
+		return -EINVAL;
+	uranges = u64_to_user_ptr(dirty.ranges);
+
+	// a new query starts a new epoch, resumed queries keep the one of their first call
+	ret = char_hw_dirty_begin(hw, dirty.data != 0, dirty.start == 0 ? &dirty.epoch : NULL);
+	if(ret < 0)
+		return ret;
+
+	pos = dirty.start;
+	while(count < dirty.count)
+	{
+		pos = char_hw_dirty_next(hw, dirty.since, pos, &num_regs, &regs);
+		if(pos >= hw->data_size)
+			break;
+
+		// store data of the range after data of previous ranges (as much as fits)
+		if(dirty.data)
+		{
+			num_regs = min_t(u64, num_regs, dirty.data_len - copied);
+			if(num_regs == 0)
+				break;
+			if(copy_to_user(u64_to_user_ptr(dirty.data + copied), regs, num_regs))
+			{
+				ret = -EFAULT;
+				break;
+			}
+			copied += num_regs;
+		}
+
+		range.offset = pos;
+		range.len = num_regs;
+		if(copy_to_user(&uranges[count], &range, sizeof(range)))
+		{
+			ret = -EFAULT;
+			break;
+		}
+		count++;
+		pos += num_regs;
+	}
+	char_hw_dirty_end(hw, dirty.data != 0, ret < 0 ? ret : (ssize_t)copied);
+	if(ret < 0)
+		return ret;
+
+	// return ranges found and where to resume
+	dirty.start = pos;
+	dirty.count = count;
+	dirty.data_len = copied;
+	if(copy_to_user(udirty, &dirty, sizeof(dirty)))
+		return -EFAULT;
+	return 0;
+}
+
+/* Function: Compare data registers with a user buffer, chunk by chunk */
+static ssize_t char_driver_compare(char_inst_t *inst, char_region_t *region)
+{
+	size_t chunk = min_t(u64, region->len, CHAR_COMPARE_CHUNK);
+	size_t n, mismatch;
+	ssize_t ret = 0;
+	u64 done = 0;
+	char *kbuf;
+
+	region->mismatch = region->offset;
+	kbuf = kvmalloc(max_t(size_t, chunk, 1), GFP_KERNEL);
+	if(!kbuf)
+		return -ENOMEM;
+
+	do
+	{
+		n = min_t(u64, chunk, region->len - done);
+		if(copy_from_user(kbuf, u64_to_user_ptr(region->addr + done), n))
+		{
+			ret = -EFAULT;
+			break;
+		}
+		ret = char_hw_compare_data(inst->char_hw, region->offset + done, n, kbuf, &mismatch);
+		if(ret < 0)
+			break;
+		done += ret;
+		region->mismatch = region->offset + done;
+	} while(mismatch == n && done < region->len && ret == n); // stop at a difference or the end
+
+	kvfree(kbuf);
+	if(ret < 0 && done == 0)
+		return ret;
+	return done;
+}
+
+/* Function: Checksum, fill or compare a range of data registers */
+static long char_driver_region(char_inst_t *inst, unsigned int cmd, char_region_t __user *uregion)
+{
+	unsigned char pattern[CHAR_FILL_MAX_PATTERN];
+	char_region_t region;
+	ssize_t ret;
+	u32 crc;
+
+	if(copy_from_user(&region, uregion, sizeof(region)))
+		return -EFAULT;
+	if(region.offset > LLONG_MAX || region.len > LLONG_MAX)
+		return -EINVAL;
+
+	switch(cmd)
+	{
+		case CHAR_CRC32C:
+			if(region.addr || region.addr_len)
+				return -EINVAL;
+			// crc32c() works on the inverted CRC
+			crc = ~region.crc;
+			ret = char_hw_crc32c(inst->char_hw, region.offset, region.len, &crc);
+			region.crc = ~crc;
+			break;
+		case CHAR_FILL:
+			if(region.addr_len == 0 || region.addr_len > CHAR_FILL_MAX_PATTERN)
+				return -EINVAL;
+			if(copy_from_user(pattern, u64_to_user_ptr(region.addr), region.addr_len))
+				return -EFAULT;
+			ret = char_hw_fill_data(inst->char_hw, region.offset, region.len, pattern, region.addr_len);
+			break;
+		default:
+			if(region.addr_len)
+				return -EINVAL;
+			ret = char_driver_compare(inst, &region);
+			break;
+	}
+	if(ret < 0)
+		return ret;
+
+	// return number of registers processed and results
+	region.len = ret;
+	if(copy_to_user(uregion, &region, sizeof(region)))
+		return -EFAULT;
+	return 0;
+}
+
+/* Function: Atomic read-modify-write of a data register */
+static long char_driver_atomic(char_inst_t *inst, char_atomic_t __user *uatomic)
+{
+	char_atomic_t atomic;
+	int ret;
+
+	// operations are passed to the device layer as they are
+	BUILD_BUG_ON(CHAR_ATOMIC_ADD != CHAR_HW_ATOMIC_ADD || CHAR_ATOMIC_CAS != CHAR_HW_ATOMIC_CAS ||
+		     CHAR_ATOMIC_XCHG != CHAR_HW_ATOMIC_XCHG || CHAR_ATOMIC_AND != CHAR_HW_ATOMIC_AND ||
+		     CHAR_ATOMIC_OR != CHAR_HW_ATOMIC_OR);
+
+	if(copy_from_user(&atomic, uatomic, sizeof(atomic)))
+		return -EFAULT;
+	if(atomic.offset > LLONG_MAX)
+		return -EINVAL;
+
+	ret = char_hw_atomic(inst->char_hw, atomic.offset, atomic.size, atomic.op, atomic.value, atomic.expected, &atomic.old);
+	if(ret < 0)
+		return ret;
+
+	if(put_user(atomic.old, &uatomic->old))
+		return -EFAULT;
+	return 0;
+}
+
+/* Functions: Entry points of snapshot files */
+static int char_snap_release(struct inode *inode, struct file *filp)
+{
+	char_hw_snap_destroy(filp->private_data);
+	return 0;
+}
+
+static loff_t char_snap_llseek(struct file *filp, loff_t off, int whence)
+{
+	char_snap_t *snap = filp->private_data;
+
+	return fixed_size_llseek(filp, off, whence, snap->hw->data_size);
+}
+
+static ssize_t char_snap_read_iter(struct kiocb *iocb, struct iov_iter *to)
+{
+	char_snap_t *snap = iocb->ki_filp->private_data;
+	unsigned char *regs = NULL;
+	ssize_t num_bytes;
+	size_t copied, total = 0;
+
+	// copy stripe by stripe, each from the snapshot or from live data registers
+	while(iov_iter_count(to))
+	{
+		num_bytes = char_hw_snap_read_begin(snap, iocb->ki_pos, iov_iter_count(to), &regs);
+		if(num_bytes <= 0)
+			break;
+
+		copied = copy_to_iter(regs, num_bytes, to);
+		char_hw_snap_read_end(snap, iocb->ki_pos, num_bytes, copied ? (ssize_t)copied : -EFAULT);
+		if(copied == 0)
+			return total ? total : -EFAULT;
+
+		total += copied;
+		iocb->ki_pos += copied;
+		if(copied < num_bytes)
+			break;
+	}
+
+	return total;
+}
+
+/* Functions: Pipe buffers holding pages of a snapshot (never stolen, the snapshot may still use them) */
+static const struct pipe_buf_operations char_snap_pipe_buf_ops =
+{
+	.release = generic_pipe_buf_release,
+	.get = generic_pipe_buf_get,
+};
+
+static void char_snap_spd_release(struct splice_pipe_desc *spd, unsigned int i)
+{
+	put_page(spd->pages[i]);
+}
+
+/* Function: Move data of a snapshot into a pipe
+   Note: a snapshot copied completely never changes, its pages are lent to the pipe
+		 without copying (they outlive the snapshot as long as the pipe holds them);
+		 otherwise data is copied like by read(), live stripes may still change
+*/
+static ssize_t char_snap_splice_read(struct file *filp, loff_t *ppos, struct pipe_inode_info *pipe,
+                                     size_t len, unsigned int flags)
+{
+	char_snap_t *snap = filp->private_data;
+	struct page *pages[PIPE_DEF_BUFFERS];
+	struct partial_page partial[PIPE_DEF_BUFFERS];
+	struct splice_pipe_desc spd =
+	{
+		.pages = pages,
+		.partial = partial,
+		.nr_pages_max = PIPE_DEF_BUFFERS,
+		.ops = &char_snap_pipe_buf_ops,
+		.spd_release = char_snap_spd_release,
+	};
+	loff_t pos = *ppos;
+	ssize_t ret;
+
+	if(!smp_load_acquire(&snap->complete))
+		return char_driver_copy_splice_read(filp, ppos, pipe, len, flags);
+
+	if(pos < 0)
+		return -EINVAL;
+	if(pos >= snap->hw->data_size)
+		return 0;
+	len = min_t(size_t, len, snap->hw->data_size - pos);
+
+	// one pipe buffer per page of the snapshot
+	while(len && spd.nr_pages < PIPE_DEF_BUFFERS)
+	{
+		unsigned int off = offset_in_page(pos);
+		unsigned int n = min_t(size_t, len, PAGE_SIZE - off);
+		struct page *page = vmalloc_to_page(snap->data_regs + pos);
+
+		get_page(page);
+		pages[spd.nr_pages] = page;
+		partial[spd.nr_pages].offset = off;
+		partial[spd.nr_pages].len = n;
+		spd.nr_pages++;
+		pos += n;
+		len -= n;
+	}
+
+	ret = splice_to_pipe(pipe, &spd);
+	if(ret > 0)
+	{
+		*ppos += ret;
+		char_hw_count_read(snap->hw, ret);
+	}
+	return ret;
+}
+
+static int char_snap_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	char_snap_t *snap = filp->private_data;
+
+	// Only a snapshot copied completely lives in its own pages
+	if(!smp_load_acquire(&snap->complete))
+		return -EINVAL;
+	if(vma->vm_flags & VM_WRITE)
+		return -EACCES;
+	char_vma_mod_flags(vma, 0, VM_MAYWRITE); // nor with mprotect()
+
+	return remap_vmalloc_range(vma, snap->data_regs, vma->vm_pgoff);
+}
+
+static const struct file_operations char_snap_fops =
+{
+	.owner = THIS_MODULE,
+	.llseek = char_snap_llseek,
+	.release = char_snap_release,
+	.read_iter = char_snap_read_iter,
+	.splice_read = char_snap_splice_read,
+	.mmap = char_snap_mmap,
+};
+
+/* Function: Take a snapshot of data registers and return it as a new file descriptor */
+static long char_driver_snapshot(char_inst_t *inst, char_snapshot_t __user *usnap)
+{
+	char_snapshot_t snapshot;
+	char_snap_t *snap;
+	struct file *file;
+	int fd;
+
+	if(copy_from_user(&snapshot, usnap, sizeof(snapshot)))
+		return -EFAULT;
+	if(snapshot.flags & ~CHAR_SNAPSHOT_COPY)
+		return -EINVAL;
+
+	fd = get_unused_fd_flags(O_CLOEXEC);
+	if(fd < 0)
+		return fd;
+
+	snap = char_hw_snap_create(inst->char_hw, snapshot.flags & CHAR_SNAPSHOT_COPY);
+	if(IS_ERR(snap))
+	{
+		put_unused_fd(fd);
+		return PTR_ERR(snap);
+	}
+
+	file = anon_inode_getfile("[char_snapshot]", &char_snap_fops, snap, O_RDONLY);
+	if(IS_ERR(file))
+	{
+		char_hw_snap_destroy(snap);
+		put_unused_fd(fd);
+		return PTR_ERR(file);
+	}
+	file->f_mode |= FMODE_LSEEK | FMODE_PREAD;
+
+	// the descriptor becomes visible only once the caller knows it (fput releases the snapshot)
+	if(put_user(fd, &usnap->fd))
+	{
+		fput(file);
+		put_unused_fd(fd);
+		return -EFAULT;
+	}
+	fd_install(fd, file);
+	pr_debug("snapshot of data registers taken (fd %d)\n", fd);
+	return 0;
+}
+
+/* Function: Simulated interrupt of the device, a request completed in the timing model
+   Note: runs in hard interrupt context, the bottom half does the rest
+*/
+static enum hrtimer_restart char_driver_irq(struct hrtimer *timer)
+{
+	char_req_t *req = container_of(timer, char_req_t, timer);
+	char_inst_t *inst = req->inst;
+
+	llist_add(&req->irq_node, &inst->irq_list);
+	schedule_work(&inst->irq_work);
+	return HRTIMER_NORESTART;
+}
+
+/* Function: Transfer the data of a completed request, in the address space of its submitter
+   Return: number of registers copied, or negative error code
+*/
+static ssize_t char_req_transfer(char_req_t *req)
+{
+	ssize_t ret;
+
+	// the submitter exited meanwhile, its buffer went away
+	if(!mmget_not_zero(req->mm))
+		return -EFAULT;
+
+	kthread_use_mm(req->mm);
+	ret = char_driver_copy_range(req->inst->char_hw, req->offset, req->len, u64_to_user_ptr(req->addr), req->write);
+	kthread_unuse_mm(req->mm);
+	mmput(req->mm);
+	return ret;
+}
+
+/* Function: Bottom half of simulated interrupts, transfer data and queue completions on their files */
+static void char_driver_irq_bh(struct work_struct *work)
+{
+	char_inst_t *inst = container_of(work, char_inst_t, irq_work);
+	struct llist_node *irqs = llist_reverse_order(llist_del_all(&inst->irq_list)); // in order of interrupts
+	char_req_t *req, *tmp;
+
+	llist_for_each_entry_safe(req, tmp, irqs, irq_node)
+	{
+		char_file_t *cf = req->owner;
+
+		req->result = char_req_transfer(req);
+		char_file_count_io(cf, req->write, req->result);
+		req->done_ns = ktime_get_ns();
+
+		// wake up under the lock: release frees the file once no request is in flight
+		spin_lock(&cf->async_lock);
+		list_move_tail(&req->node, &cf->async_done);
+		cf->async_nr_done++;
+		wake_up_poll(&cf->async_wq, EPOLLPRI);
+		spin_unlock(&cf->async_lock);
+	}
+}
+
+/* Function: Submit one asynchronous read/write, its completion comes from the timing model */
+static int char_driver_async_one(char_file_t *cf, char_async_req_t *areq)
+{
+	char_inst_t *inst = cf->inst;
+	bool write = areq->op == CHAR_ASYNC_WRITE;
+	char_req_t *req;
+	u64 done_ns, bytes;
+
+	if(areq->op > CHAR_ASYNC_WRITE || areq->reserved || areq->offset > LLONG_MAX)
+		return -EINVAL;
+
+	req = kzalloc(sizeof(*req), GFP_KERNEL);
+	if(!req)
+		return -ENOMEM;
+
+	spin_lock(&cf->async_lock);
+	if(cf->async_nr >= CHAR_ASYNC_MAX_REQS)
+	{
+		spin_unlock(&cf->async_lock);
+		kfree(req);
+		return -EAGAIN;
+	}
+	cf->async_nr++;
+	spin_unlock(&cf->async_lock);
+
+	req->inst = inst;
+	req->owner = cf;
+	req->mm = current->mm;
+	mmgrab(req->mm);
+	req->user_data = areq->user_data;
+	req->offset = areq->offset;
+	req->addr = areq->addr;
+	req->len = areq->len;
+	req->write = write;
+	req->submit_ns = ktime_get_ns();
+
+	// Data moves when the device completes, in the bottom half (errors complete as well)
+	bytes = areq->offset < inst->char_hw->data_size ? min_t(u64, areq->len, inst->char_hw->data_size - areq->offset) : 0;
+	done_ns = char_hw_model_complete(inst->char_hw, req->submit_ns, bytes);
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 13, 0)
+	hrtimer_setup(&req->timer, char_driver_irq, CLOCK_MONOTONIC, HRTIMER_MODE_ABS_HARD);
+#else
+	hrtimer_init(&req->timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS_HARD);
+	req->timer.function = char_driver_irq;
+#endif
+
+	// an interrupt of the past is raised at once
+	spin_lock(&cf->async_lock);
+	list_add_tail(&req->node, &cf->async_inflight);
+	hrtimer_start(&req->timer, ns_to_ktime(done_ns), HRTIMER_MODE_ABS_HARD);
+	spin_unlock(&cf->async_lock);
+	return 0;
+}
+
+/* Function: Submit asynchronous reads/writes */
+static long char_driver_async_submit(char_file_t *cf, char_async_submit_t __user *usubmit)
+{
+	char_async_req_t __user *ureqs;
+	char_async_submit_t submit;
+	char_async_req_t areq;
+	int ret = 0;
+	u32 i;
+
+	if(copy_from_user(&submit, usubmit, sizeof(submit)))
+		return -EFAULT;
+	ureqs = u64_to_user_ptr(submit.reqs);
+
+	for(i = 0; i < submit.nr; i++)
+	{
+		if(copy_from_user(&areq, &ureqs[i], sizeof(areq)))
+		{
+			ret = -EFAULT;
+			break;
+		}
+		ret = char_driver_async_one(cf, &areq);
+		if(ret < 0)
+			break;
+	}
+
+	// an error is returned only if no request was submitted
+	if(put_user(i, &usubmit->submitted))
+		return -EFAULT;
+	return i ? 0 : ret;
+}
+
+static bool char_file_async_ready(char_file_t *cf, u32 min_nr)
+{
+	return READ_ONCE(cf->async_nr_done) >= min_nr;
+}
+
+/* Function: Reap completions of asynchronous reads/writes */
+static long char_driver_async_reap(char_file_t *cf, char_async_reap_t __user *ureap)
+{
+	char_async_cqe_t __user *ucqes;
+	char_async_reap_t reap;
+	char_async_cqe_t cqe;
+	char_req_t *req;
+	long ret = 0;
+	u32 reaped = 0;
+
+	if(copy_from_user(&reap, ureap, sizeof(reap)))
+		return -EFAULT;
+	if(reap.reserved || reap.min_nr > reap.max_nr)
+		return -EINVAL;
+	ucqes = u64_to_user_ptr(reap.cqes);
+
+	// Wait for min_nr completions, a timeout returns what completed meanwhile
+	if(reap.timeout_ns < 0)
+		ret = wait_event_interruptible(cf->async_wq, char_file_async_ready(cf, reap.min_nr));
+	else if(reap.timeout_ns > 0)
+		ret = wait_event_interruptible_hrtimeout(cf->async_wq, char_file_async_ready(cf, reap.min_nr),
+							 ns_to_ktime(reap.timeout_ns));
+	if(ret == -ERESTARTSYS)
+		return ret;
+	ret = 0;
+
+	while(reaped < reap.max_nr)
+	{
+		spin_lock(&cf->async_lock);
+		req = list_first_entry_or_null(&cf->async_done, char_req_t, node);
+		if(req)
+		{
+			list_del(&req->node);
+			cf->async_nr--;
+			cf->async_nr_done--;
+		}
+		spin_unlock(&cf->async_lock);
+		if(!req)
+			break;
+
+		cqe.user_data = req->user_data;
+		cqe.result = req->result;
+		cqe.latency_ns = req->done_ns - req->submit_ns;
+		if(copy_to_user(&ucqes[reaped], &cqe, sizeof(cqe)))
+		{
+			// keep the completion for the next reap
+			spin_lock(&cf->async_lock);
+			list_add(&req->node, &cf->async_done);
+			cf->async_nr++;
+			cf->async_nr_done++;
+			spin_unlock(&cf->async_lock);
+			ret = -EFAULT;
+			break;
+		}
+		char_req_free(req);
+		reaped++;
+	}
+
+	if(put_user(reaped, &ureap->reaped))
+		return -EFAULT;
+	return reaped ? 0 : ret;
+}
+
+/* Functions: Count shared writable mappings, for dirty tracking */
+static void char_driver_vm_open(struct vm_area_struct *vma)
+{
+	char_inst_t *inst = vma->vm_private_data;
+	char_hw_get_wr_mapping(inst->char_hw);
+}
+
+static void char_driver_vm_close(struct vm_area_struct *vma)
+{
+	char_inst_t *inst = vma->vm_private_data;
+	char_hw_put_wr_mapping(inst->char_hw);
+}
+
+/* Function: Map a page of data registers on first access, once the permission bits allow it
+	(no page_mkwrite: data pages have no page cache mapping, a writable mapping gets writable pages)
+*/
+static vm_fault_t char_driver_vm_fault(struct vm_fault *vmf)
+{
+	struct vm_area_struct *vma = vmf->vma;
+	char_inst_t *inst = vma->vm_private_data;
+	char_dev_t *hw = inst->char_hw;
+	vm_fault_t ret;
+
+	// a revocation zaps mappings after changing the permission, never in between check and insert
+	down_read(&inst->map_lock);
+	if(char_driver_vm_perm(hw, vma->vm_flags) < 0 || vmf->pgoff >= hw->nr_data_pages)
+		ret = VM_FAULT_SIGBUS;
+	else
+		ret = vmf_insert_page(vma, vmf->address, hw->data_pages[vmf->pgoff]);
+	up_read(&inst->map_lock);
+	return ret;
+}
+
+/* Function: Do not allow mprotect() to grant what the control register denies now */
+static int char_driver_vm_mprotect(struct vm_area_struct *vma, unsigned long start, unsigned long end,
+                                   unsigned long newflags)
+{
+	char_inst_t *inst = vma->vm_private_data;
+	return char_driver_vm_perm(inst->char_hw, newflags);
+}
+
+static const struct vm_operations_struct char_driver_vm_ops =
+{
+	.fault = char_driver_vm_fault,
+	.mprotect = char_driver_vm_mprotect,
+};
+
+static const struct vm_operations_struct char_driver_wr_vm_ops =
+{
+	.open = char_driver_vm_open,
+	.close = char_driver_vm_close,
+	.fault = char_driver_vm_fault,
+	.mprotect = char_driver_vm_mprotect,
+};
+
+/* Functions: dma-buf operations of exported data registers */
+static int char_dmabuf_attach(struct dma_buf *dmabuf, struct dma_buf_attachment *attach)
+{
+	char_dmabuf_t *db = dmabuf->priv;
+	char_dmabuf_attach_t *a;
+	int ret;
+
+	a = kzalloc(sizeof(*a), GFP_KERNEL);
+	if(!a)
+		return -ENOMEM;
+
+	ret = sg_alloc_table_from_pages(&a->sgt, db->inst->char_hw->data_pages + db->pgoff, db->nr_pages, 0,
+					db->nr_pages << PAGE_SHIFT, GFP_KERNEL);
+	if(ret < 0)
+	{
+		kfree(a);
+		return ret;
+	}
+
+	a->dev = attach->dev;
+	attach->priv = a;
+	mutex_lock(&db->lock);
+	list_add(&a->node, &db->attachments);
+	mutex_unlock(&db->lock);
+	return 0;
+}
+
+static void char_dmabuf_detach(struct dma_buf *dmabuf, struct dma_buf_attachment *attach)
+{
+	char_dmabuf_t *db = dmabuf->priv;
+	char_dmabuf_attach_t *a = attach->priv;
+
+	mutex_lock(&db->lock);
+	list_del(&a->node);
+	mutex_unlock(&db->lock);
+	sg_free_table(&a->sgt);
+	kfree(a);
+}
+
+static struct sg_table *char_dmabuf_map(struct dma_buf_attachment *attach, enum dma_data_direction dir)
+{
+	char_dmabuf_t *db = attach->dmabuf->priv;
+	char_dmabuf_attach_t *a = attach->priv;
+	int ret;
+
+	// devices write only into a writable export
+	if(!db->writable && dir != DMA_TO_DEVICE)
+		return ERR_PTR(-EPERM);
+
+	ret = dma_map_sgtable(a->dev, &a->sgt, dir, 0);
+	if(ret < 0)
+		return ERR_PTR(ret);
+
+	mutex_lock(&db->lock);
+	a->mapped = true;
+	mutex_unlock(&db->lock);
+	return &a->sgt;
+}
+
+static void char_dmabuf_unmap(struct dma_buf_attachment *attach, struct sg_table *sgt, enum dma_data_direction dir)
+{
+	char_dmabuf_t *db = attach->dmabuf->priv;
+	char_dmabuf_attach_t *a = attach->priv;
+
+	mutex_lock(&db->lock);
+	a->mapped = false;
+	mutex_unlock(&db->lock);
+	dma_unmap_sgtable(a->dev, sgt, dir, 0);
+}
+
+static int char_dmabuf_begin_cpu_access(struct dma_buf *dmabuf, enum dma_data_direction dir)
+{
+	char_dmabuf_t *db = dmabuf->priv;
+	void *regs = db->inst->char_hw->data_regs + ((loff_t)db->pgoff << PAGE_SHIFT);
+	char_dmabuf_attach_t *a;
+
+	// Writes of devices become visible to the CPU, also through the kernel alias of data registers
+	mutex_lock(&db->lock);
+	list_for_each_entry(a, &db->attachments, node)
+	{
+		if(a->mapped)
+			dma_sync_sgtable_for_cpu(a->dev, &a->sgt, dir);
+	}
+	mutex_unlock(&db->lock);
+
+	if(is_vmalloc_addr(regs))
+		invalidate_kernel_vmap_range(regs, db->nr_pages << PAGE_SHIFT);
+	return 0;
+}
+
+static int char_dmabuf_end_cpu_access(struct dma_buf *dmabuf, enum dma_data_direction dir)
+{
+	char_dmabuf_t *db = dmabuf->priv;
+	void *regs = db->inst->char_hw->data_regs + ((loff_t)db->pgoff << PAGE_SHIFT);
+	char_dmabuf_attach_t *a;
+
+	// Writes of the CPU become visible to devices
+	if(is_vmalloc_addr(regs))
+		flush_kernel_vmap_range(regs, db->nr_pages << PAGE_SHIFT);
+
+	mutex_lock(&db->lock);
+	list_for_each_entry(a, &db->attachments, node)
+	{
+		if(a->mapped)
+			dma_sync_sgtable_for_device(a->dev, &a->sgt, dir);
+	}
+	mutex_unlock(&db->lock);
+	return 0;
+}
+
+static int char_dmabuf_mmap(struct dma_buf *dmabuf, struct vm_area_struct *vma)
+{
+	char_dmabuf_t *db = dmabuf->priv;
+	char_dev_t *hw = db->inst->char_hw;
+	int ret;
+
+	// a read-only export is a read-only file, shared mappings of it cannot become writable
+	ret = char_driver_mmap_perm(hw, vma);
+	if(ret < 0)
+		return ret;
+
+	// the dma-buf core checked the range against the size of the dma-buf:
+		// fault in pages of data registers like device mappings (revoked with them),
+		// offsets become offsets of data registers and the mapping cannot grow past the export
+	vma->vm_pgoff += db->pgoff;
+	vma->vm_private_data = db->inst;
+	vma->vm_ops = &char_driver_vm_ops;
+	char_vma_mod_flags(vma, VM_MIXEDMAP | VM_DONTEXPAND, 0);
+	return 0;
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 18, 0)
+static int char_dmabuf_vmap(struct dma_buf *dmabuf, struct iosys_map *map)
+#else
+static int char_dmabuf_vmap(struct dma_buf *dmabuf, struct dma_buf_map *map)
+#endif
+{
+	char_dmabuf_t *db = dmabuf->priv;
+	void *regs = db->inst->char_hw->data_regs + ((loff_t)db->pgoff << PAGE_SHIFT);
+
+	// data registers are mapped in the kernel for their whole life
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 18, 0)
+	iosys_map_set_vaddr(map, regs);
+#else
+	dma_buf_map_set_vaddr(map, regs);
+#endif
+	return 0;
+}
+
+static void char_dmabuf_release(struct dma_buf *dmabuf)
+{
+	char_dmabuf_t *db = dmabuf->priv;
+	char_inst_t *inst = db->inst;
+
+	mutex_lock(&inst->dmabufs_lock);
+	list_del(&db->node);
+	mutex_unlock(&inst->dmabufs_lock);
+	iput(db->inode);
+
+	if(db->writable)
+		char_hw_put_wr_mapping(inst->char_hw);
+	kfree(db);
+}
+
+static const struct dma_buf_ops char_dmabuf_ops =
+{
+	.attach = char_dmabuf_attach,
+	.detach = char_dmabuf_detach,
+	.map_dma_buf = char_dmabuf_map,
+	.unmap_dma_buf = char_dmabuf_unmap,
+	.begin_cpu_access = char_dmabuf_begin_cpu_access,
+	.end_cpu_access = char_dmabuf_end_cpu_access,
+	.mmap = char_dmabuf_mmap,
+	.vmap = char_dmabuf_vmap,
+	.release = char_dmabuf_release,
+};
+
+/* Function: Export a range of data registers as a dma-buf and return it as a new file descriptor */
+static long char_driver_export_dmabuf(char_inst_t *inst, char_dmabuf_export_t __user *uexport)
+{
+	DEFINE_DMA_BUF_EXPORT_INFO(exp_info); // owner: the dma-buf pins the module
+	char_dev_t *hw = inst->char_hw;
+	char_dmabuf_export_t export;
+	struct dma_buf *dmabuf;
+	char_dmabuf_t *db;
+	unsigned char ctrl;
+	bool writable;
+	int fd, ret;
+
+	if(copy_from_user(&export, uexport, sizeof(export)))
+		return -EFAULT;
+	if(export.flags & ~CHAR_DMABUF_WRITE)
+		return -EINVAL;
+	if((export.offset & ~PAGE_MASK) || export.offset >= hw->data_size)
+		return -EINVAL;
+	if(export.len == 0)
+		export.len = hw->data_size - export.offset;
+	if(export.len > hw->data_size - export.offset)
+		return -EINVAL;
+	writable = export.flags & CHAR_DMABUF_WRITE;
+
+	// Exports follow the permission bits of CONTROL_ACCESS_REG, like mappings
+	ctrl = READ_ONCE(hw->control_regs[CONTROL_ACCESS_REG]);
+	if((ctrl & CTRL_READ_DATA_BIT) == DISABLE || (writable && (ctrl & CTRL_WRITE_DATA_BIT) == DISABLE))
+		return -EACCES;
+
+	db = kzalloc(sizeof(*db), GFP_KERNEL);
+	if(!db)
+		return -ENOMEM;
+	db->inst = inst;
+	db->pgoff = export.offset >> PAGE_SHIFT;
+	db->nr_pages = DIV_ROUND_UP(export.len, PAGE_SIZE);
+	db->writable = writable;
+	INIT_LIST_HEAD(&db->attachments);
+	mutex_init(&db->lock);
+
+	// Writes of devices and processes through the dma-buf are not tracked (see char_driver_mmap)
+	if(writable)
+	{
+		ret = char_hw_new_wr_mapping(hw);
+		if(ret < 0)
+			goto failed_wr_mapping;
+	}
+
+	exp_info.ops = &char_dmabuf_ops;
+	exp_info.size = db->nr_pages << PAGE_SHIFT;
+	exp_info.flags = writable ? O_RDWR : O_RDONLY;
+	exp_info.priv = db;
+	dmabuf = dma_buf_export(&exp_info);
+	if(IS_ERR(dmabuf))
+	{
+		ret = PTR_ERR(dmabuf);
+		goto failed_export;
+	}
+
+	// from here the last dma_buf_put() releases db (the inode stays until then)
+	db->inode = igrab(file_inode(dmabuf->file));
+	mutex_lock(&inst->dmabufs_lock);
+	list_add_tail(&db->node, &inst->dmabufs);
+	mutex_unlock(&inst->dmabufs_lock);
+
+	fd = get_unused_fd_flags(O_CLOEXEC);
+	if(fd < 0)
+	{
+		dma_buf_put(dmabuf);
+		return fd;
+	}
+
+	// the descriptor becomes visible only once the caller knows it
+	if(put_user(fd, &uexport->fd))
+	{
+		dma_buf_put(dmabuf);
+		put_unused_fd(fd);
+		return -EFAULT;
+	}
+	fd_install(fd, dmabuf->file);
+	pr_debug("data registers %llu+%llu exported as dma-buf (fd %d)\n", export.offset, export.len, fd);
+	return 0;
+
+failed_export:
+	if(writable)
+		char_hw_put_wr_mapping(hw);
+
+failed_wr_mapping:
+	kfree(db);
+	return ret;
+}
+
+/* Function: Execute a control/data command (shared by ioctl and io_uring) */
+static long char_driver_do_cmd(char_file_t *cf, unsigned int cmd, void __user *argp)
+{
+	char_inst_t *inst = cf->inst;
+	long ret = 0;
+
+	switch (cmd)
+	{
+		case CHAR_CLR_DATA_REGS:
+		{
+			ret = char_hw_clear_data(inst->char_hw);
+			if(ret < 0)
+				dev_dbg(inst->dev, "can not clear data registers\n");
+			else
+			{
+				dev_dbg(inst->dev, "data registers have been cleared\n");
+				char_driver_wake_fifo(inst); // FIFO is empty now
+			}
+		}
+			break;
+		case CHAR_SET_RD_DATA_REGS:
+		{
+			unsigned char isReadEnable;
+			if(copy_from_user(&isReadEnable, argp, sizeof(isReadEnable))) // get current permission from user
+				return -EFAULT;
+			char_hw_enable_read(inst->char_hw, isReadEnable); // set permission
+			char_driver_wake_fifo(inst); // FIFO readers fail now or may go on
+			if(isReadEnable != ENABLE)
+				char_driver_revoke_maps(inst);
+			dev_dbg(inst->dev, "data registers have been %s to read\n", (isReadEnable == ENABLE)?"enable":"disable");
+		}
+			break;
+		case CHAR_SET_WR_DATA_REGS:
+		{
+			unsigned char isWriteEnable;
+			if(copy_from_user(&isWriteEnable, argp, sizeof(isWriteEnable))) // get current permission from user
+				return -EFAULT;
+			char_hw_enable_write(inst->char_hw, isWriteEnable); // set permission
+			char_driver_wake_fifo(inst); // FIFO writers fail now or may go on
+			if(isWriteEnable != ENABLE)
+				char_driver_revoke_maps(inst);
+			dev_dbg(inst->dev, "data registers have been %s to write\n", (isWriteEnable == ENABLE)?"enable":"disable");
+		}
+			break;
+		case CHAR_GET_STS_REGS:
+		{
+			sts_regs_t status;
+			char_hw_get_status(inst->char_hw, &status); // get current status
+			if(copy_to_user(argp, &status, sizeof(status))) // set status to user
+				return -EFAULT;
+		}
+			break;
+		case CHAR_SET_FIFO_MODE:
+		{
+			unsigned char isFifoEnable;
+			if(copy_from_user(&isFifoEnable, argp, sizeof(isFifoEnable))) // get requested mode from user
+				return -EFAULT;
+			char_hw_enable_fifo(inst->char_hw, isFifoEnable); // set mode
+			char_driver_wake_fifo(inst); // FIFO is empty now, or gone
+			dev_dbg(inst->dev, "data registers have been %s FIFO mode\n", (isFifoEnable == ENABLE)?"switched to":"switched out of");
+		}
+			break;
+		case CHAR_GET_STATS:
+		{
+			char_stats_t stats;
+			char_hw_get_stats(inst->char_hw, &stats); // sum counters of all CPUs
+			if(copy_to_user(argp, &stats, sizeof(stats)))
+				ret = -EFAULT;
+		}
+			break;
+		case CHAR_READ_RANGE:
+			ret = char_driver_rw_range(inst, argp, false);
+			break;
+		case CHAR_WRITE_RANGE:
+			ret = char_driver_rw_range(inst, argp, true);
+			break;
+		case CHAR_BATCH:
+			ret = char_driver_batch(cf, argp);
+			break;
+		case CHAR_GET_DIRTY:
+			ret = char_driver_get_dirty(inst, argp);
+			break;
+		case CHAR_SNAPSHOT:
+			ret = char_driver_snapshot(inst, argp);
+			break;
+		case CHAR_SET_FILE_FLAGS:
+		{
+			u32 flags;
+			if(copy_from_user(&flags, argp, sizeof(flags)))
+				return -EFAULT;
+			if(flags & ~CHAR_FILE_FLAGS)
+				return -EINVAL;
+			WRITE_ONCE(cf->flags, flags); // applies to the next read/write of the descriptor
+		}
+			break;
+		case CHAR_SET_EVENTFD:
+			ret = char_driver_set_eventfd(cf, argp);
+			break;
+		case CHAR_CRC32C:
+		case CHAR_FILL:
+		case CHAR_COMPARE:
+			ret = char_driver_region(inst, cmd, argp);
+			break;
+		case CHAR_ATOMIC:
+			ret = char_driver_atomic(inst, argp);
+			break;
+		case CHAR_EXPORT_DMABUF:
+			ret = char_driver_export_dmabuf(inst, argp);
+			break;
+		case CHAR_ASYNC_SUBMIT:
+			ret = char_driver_async_submit(cf, argp);
+			break;
+		case CHAR_ASYNC_REAP:
+			ret = char_driver_async_reap(cf, argp);
+			break;
+		default:
+			ret = -ENOTTY;
+			break;
+	}
+	return ret;
+}
+
+/* Function: Execute a command, measure and trace it */
+static long char_driver_trace_cmd(char_file_t *cf, unsigned int cmd, void __user *argp)
+{
+	char_inst_t *inst = cf->inst;
+	u64 start_ns = char_driver_op_start();
+	long ret = char_driver_do_cmd(cf, cmd, argp);
+	u64 latency_ns;
+
+	atomic64_inc(&cf->cmds);
+	if(ret < 0)
+		atomic64_inc(&cf->errors);
+
+	// unknown commands do not get a histogram
+	if(_IOC_TYPE(cmd) != MAGICAL_NUMBER || _IOC_NR(cmd) >= CHAR_HIST_NR_CMDS)
+		latency_ns = char_driver_op_latency(start_ns);
+	else
+		latency_ns = char_driver_op_end(inst, CHAR_HIST_CMD_BASE + _IOC_NR(cmd), start_ns);
+
+	trace_char_cmd(MINOR(inst->dev_num), cmd, ret, latency_ns);
+	return ret;
+}
+
+static long char_driver_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
+{
+	return char_driver_trace_cmd(filp->private_data, cmd, (void __user *)arg);
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 19, 0)
+static int char_driver_uring_cmd(struct io_uring_cmd *ioucmd, unsigned int issue_flags)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 5, 0)
+	const char_uring_cmd_t *ucmd = io_uring_sqe_cmd(ioucmd->sqe);
+#else
+	const char_uring_cmd_t *ucmd = ioucmd->cmd;
+#endif
+	u64 arg = READ_ONCE(ucmd->arg);
+
+	if(READ_ONCE(ucmd->reserved))
+		return -EINVAL;
+
+	// Status/statistics never wait, everything else may sleep on locks:
+	// let io_uring retry it from a worker instead of blocking the submitter
+	if((issue_flags & IO_URING_F_NONBLOCK) && ioucmd->cmd_op != CHAR_GET_STS_REGS && ioucmd->cmd_op != CHAR_GET_STATS)
+		return -EAGAIN;
+
+	return char_driver_trace_cmd(ioucmd->file->private_data, ioucmd->cmd_op, u64_to_user_ptr(arg));
+}
+#endif
+
+static __poll_t char_driver_poll(struct file *filp, poll_table *wait)
+{
+	char_file_t *cf = filp->private_data;
+	char_inst_t *inst = cf->inst;
+	char_dev_t *hw = inst->char_hw;
+	__poll_t mask = 0;
+
+	poll_wait(filp, &inst->fifo_rd_wq, wait);
+	poll_wait(filp, &inst->fifo_wr_wq, wait);
+	poll_wait(filp, &cf->async_wq, wait);
+
+	// Completions of asynchronous reads/writes wait to be reaped
+	if(READ_ONCE(cf->async_nr_done))
+		mask |= EPOLLPRI;
+
+	// Data registers addressed by offset can always be accessed
+	if(!char_file_fifo_mode(cf))
+		return mask | EPOLLIN | EPOLLRDNORM | EPOLLOUT | EPOLLWRNORM;
+
+	if(char_hw_fifo_used(hw) > 0)
+		mask |= EPOLLIN | EPOLLRDNORM;
+	if(char_hw_fifo_free(hw) > 0)
+		mask |= EPOLLOUT | EPOLLWRNORM;
+
+	return mask;
+}
+
+static int char_driver_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	char_file_t *cf = filp->private_data;
+	char_inst_t *inst = cf->inst;
+	char_dev_t *hw = inst->char_hw;
+	u64 start_ns = char_driver_op_start();
+	int ret;
+
+	// Mapping protections follow the permission bits of CONTROL_ACCESS_REG
+	ret = char_driver_mmap_perm(hw, vma);
+	if(ret < 0)
+		return ret;
+
+	// The range may not exceed the region
+	if(vma->vm_pgoff >= hw->nr_data_pages || vma_pages(vma) > hw->nr_data_pages - vma->vm_pgoff)
+		return -ENXIO;
+
+	// Writes through a shared mapping which is or may become writable are not tracked
+		// (and cannot be copied into a snapshot first)
+	if((vma->vm_flags & VM_SHARED) && (vma->vm_flags & VM_MAYWRITE))
+	{
+		ret = char_hw_new_wr_mapping(hw);
+		if(ret < 0)
+			return ret;
+		vma->vm_ops = &char_driver_wr_vm_ops;
+	}
+	else
+		vma->vm_ops = &char_driver_vm_ops;
+	vma->vm_private_data = inst;
+
+	// Data register pages are mapped on first access (char_driver_vm_fault), so that
+		// mappings can be zapped when a permission is revoked
+	char_vma_mod_flags(vma, VM_MIXEDMAP, 0);
+
+	// A mapping counts as one access in the reading/writing data time
+	if(vma->vm_flags & VM_READ)
+		char_hw_count_read(hw, 0);
+	if(vma->vm_flags & VM_WRITE)
+		char_hw_count_write(hw, 0);
+
+	char_driver_trace_io(inst, CHAR_OP_MMAP, (loff_t)vma->vm_pgoff << PAGE_SHIFT, vma->vm_end - vma->vm_start, 0, start_ns);
+	return 0;
+}
+
+/* Sysfs attributes: statistics counters of the device */
+#define CHAR_STATS_ATTR(name) \
+static ssize_t name##_show(struct device *dev, struct device_attribute *attr, char *buf) \
+{ \
+	char_stats_t stats; \
+	char_hw_get_stats(dev_get_drvdata(dev), &stats); \
+	return sysfs_emit(buf, "%llu\n", stats.name); \
+} \
+static DEVICE_ATTR_RO(name)
+
+CHAR_STATS_ATTR(read_ops);
+CHAR_STATS_ATTR(write_ops);
+CHAR_STATS_ATTR(read_bytes);
+CHAR_STATS_ATTR(write_bytes);
+CHAR_STATS_ATTR(errors);
+CHAR_STATS_ATTR(overflows);
+
+static struct attribute *char_stats_attrs[] =
+{
+	&dev_attr_read_ops.attr,
+	&dev_attr_write_ops.attr,
+	&dev_attr_read_bytes.attr,
+	&dev_attr_write_bytes.attr,
+	&dev_attr_errors.attr,
+	&dev_attr_overflows.attr,
+	NULL,
+};
+
+static const struct attribute_group char_stats_group =
+{
+	.name = "stats",
+	.attrs = char_stats_attrs,
+};
+
+/* Sysfs attributes: control register and status registers of the device (read without locks) */
+static ssize_t control_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	unsigned char control, device_status;
+
+	char_hw_get_regs(dev_get_drvdata(dev), &control, &device_status);
+	return sysfs_emit(buf, "0x%02x\n", control);
+}
+static DEVICE_ATTR_RO(control);
+
+static ssize_t status_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	sts_regs_t status;
+
+	// read_count write_count device_status, as CHAR_GET_STS_REGS returns them
+	char_hw_get_status(dev_get_drvdata(dev), &status);
+	return sysfs_emit(buf, "%u %u 0x%02x\n",
+	                  status.read_count_h_reg << 8 | status.read_count_l_reg,
+	                  status.write_count_h_reg << 8 | status.write_count_l_reg,
+	                  status.device_status_reg);
+}
+static DEVICE_ATTR_RO(status);
+
+static struct attribute *char_regs_attrs[] =
+{
+	&dev_attr_control.attr,
+	&dev_attr_status.attr,
+	NULL,
+};
+
+static const struct attribute_group char_regs_group =
+{
+	.attrs = char_regs_attrs,
+};
+
+/* Sysfs attributes: timing model of the device (asynchronous reads/writes) */
+#define CHAR_MODEL_ATTR(name) \
+static ssize_t name##_show(struct device *dev, struct device_attribute *attr, char *buf) \
+{ \
+	char_dev_t *hw = dev_get_drvdata(dev); \
+	return sysfs_emit(buf, "%llu\n", READ_ONCE(hw->model.name)); \
+} \
+static ssize_t name##_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count) \
+{ \
+	char_dev_t *hw = dev_get_drvdata(dev); \
+	u64 val; \
+	int ret = kstrtou64(buf, 0, &val); \
+	if(ret < 0) \
+		return ret; \
+	WRITE_ONCE(hw->model.name, val); /* applies to the next request */ \
+	return count; \
+} \
+static DEVICE_ATTR_RW(name)
+
+CHAR_MODEL_ATTR(latency_ns);
+CHAR_MODEL_ATTR(bandwidth);
+CHAR_MODEL_ATTR(jitter_ns);
+
+static struct attribute *char_model_attrs[] =
+{
+	&dev_attr_latency_ns.attr,
+	&dev_attr_bandwidth.attr,
+	&dev_attr_jitter_ns.attr,
+	NULL,
+};
+
+static const struct attribute_group char_model_group =
+{
+	.name = "model",
+	.attrs = char_model_attrs,
+};
+
+static const struct attribute_group *char_dev_groups[] =
+{
+	&char_regs_group,
+	&char_stats_group,
+	&char_model_group,
+	NULL,
+};
+
+/* Debugfs: latency histograms of the instance */
+static const char * const char_hist_op_names[CHAR_HIST_CMD_BASE] =
+{
+	[CHAR_OP_READ] = "read",
+	[CHAR_OP_WRITE] = "write",
+	[CHAR_OP_FIFO_READ] = "fifo_read",
+	[CHAR_OP_FIFO_WRITE] = "fifo_write",
+	[CHAR_OP_MMAP] = "mmap",
+	[CHAR_HIST_OPEN] = "open",
+	[CHAR_HIST_RELEASE] = "release",
+};
+
+static const char * const char_hist_cmd_names[CHAR_HIST_NR_CMDS] =
+{
+	[_IOC_NR(CHAR_CLR_DATA_REGS)] = "clr_data_regs",
+	[_IOC_NR(CHAR_GET_STS_REGS)] = "get_sts_regs",
+	[_IOC_NR(CHAR_SET_RD_DATA_REGS)] = "set_rd_data_regs",
+	[_IOC_NR(CHAR_SET_WR_DATA_REGS)] = "set_wr_data_regs",
+	[_IOC_NR(CHAR_GET_STATS)] = "get_stats",
+	[_IOC_NR(CHAR_SET_FIFO_MODE)] = "set_fifo_mode",
+	[_IOC_NR(CHAR_READ_RANGE)] = "read_range",
+	[_IOC_NR(CHAR_WRITE_RANGE)] = "write_range",
+	[_IOC_NR(CHAR_BATCH)] = "batch",
+	[_IOC_NR(CHAR_GET_DIRTY)] = "get_dirty",
+	[_IOC_NR(CHAR_SNAPSHOT)] = "snapshot",
+	[_IOC_NR(CHAR_SET_FILE_FLAGS)] = "set_file_flags",
+	[_IOC_NR(CHAR_SET_EVENTFD)] = "set_eventfd",
+	[_IOC_NR(CHAR_CRC32C)] = "crc32c",
+	[_IOC_NR(CHAR_FILL)] = "fill",
+	[_IOC_NR(CHAR_COMPARE)] = "compare",
+	[_IOC_NR(CHAR_ATOMIC)] = "atomic",
+	[_IOC_NR(CHAR_EXPORT_DMABUF)] = "export_dmabuf",
+	[_IOC_NR(CHAR_ASYNC_SUBMIT)] = "async_submit",
+	[_IOC_NR(CHAR_ASYNC_REAP)] = "async_reap",
+};
+
+/* Function: Upper bound (ns) of the bucket holding the given permille of latencies */
+static u64 char_hist_percentile(const u64 *buckets, u64 total, unsigned int permille)
+{
+	u64 rank = div_u64(total * permille + 999, 1000);
+	u64 sum = 0;
+	unsigned int b;
+
+	for(b = 0; b < CHAR_HIST_NR_BUCKETS; b++)
+	{
+		sum += buckets[b];
+		if(sum >= rank)
+			break;
+	}
+	return b ? 1ULL << b : 0;
+}
+
+static int char_hist_show(struct seq_file *m, void *v)
+{
+	char_inst_t *inst = m->private;
+	u64 buckets[CHAR_HIST_NR_BUCKETS];
+	unsigned int op, b;
+	int cpu;
+
+	seq_printf(m, "%-18s %12s %12s %12s %12s\n", "op", "count", "p50_ns", "p99_ns", "p999_ns");
+	for(op = 0; op < CHAR_HIST_NR_OPS; op++)
+	{
+		u64 total = 0;
+		const char *name;
+		char cmd_name[16];
+
+		// merge histograms of all CPUs
+		memset(buckets, 0, sizeof(buckets));
+		for_each_possible_cpu(cpu)
+		{
+			char_hist_t *h = per_cpu_ptr(inst->hist, cpu);
+
+			for(b = 0; b < CHAR_HIST_NR_BUCKETS; b++)
+				buckets[b] += READ_ONCE(h->buckets[op][b]);
+		}
+		for(b = 0; b < CHAR_HIST_NR_BUCKETS; b++)
+			total += buckets[b];
+
+		// entry points are always listed, commands once used
+		if(op < CHAR_HIST_CMD_BASE)
+			name = char_hist_op_names[op];
+		else if(total == 0)
+			continue;
+		else if(char_hist_cmd_names[op - CHAR_HIST_CMD_BASE])
+			name = char_hist_cmd_names[op - CHAR_HIST_CMD_BASE];
+		else
+		{
+			snprintf(cmd_name, sizeof(cmd_name), "cmd_%u", op - CHAR_HIST_CMD_BASE);
+			name = cmd_name;
+		}
+
+		seq_printf(m, "%-18s %12llu %12llu %12llu %12llu\n", name, total,
+		           char_hist_percentile(buckets, total, 500),
+		           char_hist_percentile(buckets, total, 990),
+		           char_hist_percentile(buckets, total, 999));
+	}
+	return 0;
+}
+
+static int char_hist_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, char_hist_show, inode->i_private);
+}
+
+/* Function: Reset latency histograms (operations in flight may still be counted) */
+static ssize_t char_hist_write(struct file *filp, const char __user *buf, size_t count, loff_t *ppos)
+{
+	char_inst_t *inst = ((struct seq_file *)filp->private_data)->private;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(inst->hist, cpu), 0, sizeof(char_hist_t));
+	return count;
+}
+
+static const struct file_operations char_hist_fops =
+{
+	.owner = THIS_MODULE,
+	.open = char_hist_open,
+	.read = seq_read,
+	.write = char_hist_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/* Debugfs: open files of the instance with their statistics counters */
+static int char_clients_show(struct seq_file *m, void *v)
+{
+	char_inst_t *inst = m->private;
+	char_file_t *cf;
+
+	seq_printf(m, "%-8s %-16s %5s %12s %14s %12s %14s %12s %12s\n", "pid", "comm", "flags",
+	           "read_ops", "read_bytes", "write_ops", "write_bytes", "cmds", "errors");
+	spin_lock(&inst->files_lock);
+	list_for_each_entry(cf, &inst->files, node)
+	{
+		seq_printf(m, "%-8d %-16s %5x %12lld %14lld %12lld %14lld %12lld %12lld\n", cf->pid, cf->comm,
+		           READ_ONCE(cf->flags), atomic64_read(&cf->read_ops), atomic64_read(&cf->read_bytes),
+		           atomic64_read(&cf->write_ops), atomic64_read(&cf->write_bytes),
+		           atomic64_read(&cf->cmds), atomic64_read(&cf->errors));
+	}
+	spin_unlock(&inst->files_lock);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(char_clients);
+
+/* 
+	File Operations structure includes function pointers. 
+    It create a 1-1 link between system calls and entry points of the driver
+*/
+static struct file_operations fops =
+{
+	.owner = THIS_MODULE,
+	.llseek = char_driver_llseek,
+	.open = char_driver_open,
+	.release = char_driver_release,
+	.read_iter = char_driver_read_iter,
+	.write_iter = char_driver_write_iter,
+	.splice_read = char_driver_copy_splice_read,
+	.splice_write = iter_file_splice_write,
+	.unlocked_ioctl = char_driver_ioctl,
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 19, 0)
+	.uring_cmd = char_driver_uring_cmd,
+#endif
+	.poll = char_driver_poll,
+	.mmap = char_driver_mmap,
+};
+
+/* Function: Create a device instance
+   Parameters:
+		* inst: pointer to device instance
+		* index: index of the instance, device file is char_device_file<index>
+		* node: NUMA node of hardware device buffers
+*/
+static int char_driver_create_inst(char_inst_t *inst, unsigned int index, int node)
+{
+	int ret = 0;
+
+	inst->dev_num = MKDEV(MAJOR(char_drv.dev_num), MINOR(char_drv.dev_num) + index);
+	inst->node = node;
+	init_waitqueue_head(&inst->fifo_rd_wq);
+	init_waitqueue_head(&inst->fifo_wr_wq);
+	INIT_LIST_HEAD(&inst->files);
+	spin_lock_init(&inst->files_lock);
+	init_rwsem(&inst->map_lock);
+	INIT_LIST_HEAD(&inst->dmabufs);
+	mutex_init(&inst->dmabufs_lock);
+	INIT_LIST_HEAD(&inst->subs);
+	mutex_init(&inst->subs_lock);
+
+	/* Register handling interrupt function (bottom half of simulated interrupts) */
+	init_llist_head(&inst->irq_list);
+	INIT_WORK(&inst->irq_work, char_driver_irq_bh);
+
+	/* Allocate memory for driver data structure & Initialize */
+	inst->hist = alloc_percpu(char_hist_t); // latency histograms
+	if(!inst->hist)
+		return -ENOMEM;
+
+	inst->char_hw = kzalloc_node(sizeof(char_dev_t), GFP_KERNEL, node); // allocate memory
+	if(!inst->char_hw)
+	{
+		pr_err("failed to allocate data structure of the driver\n");
+		ret = -ENOMEM;
+		goto failed_alloc_hw;
+	}
+
+	/* Initialize hardware device */
+	ret = char_hw_init(inst->char_hw, data_size, dirty_shift, node);
+	if(ret < 0)
+	{
+		pr_err("failed to initialize a virtual character device\n");
+		goto failed_init_hw;
+	}
+	char_hw_set_notify(inst->char_hw, char_driver_notify, inst); // events for eventfd subscribers
+	char_hw_set_model(inst->char_hw, model_latency_ns, model_bandwidth, model_jitter_ns);
+
+	/* Create Device File */
+		// create device name "char_device_file<index>" with allocated device number
+		// (statistics counters are exported as sysfs attributes of the device)
+	inst->dev = device_create_with_groups(char_drv.dev_class, NULL, inst->dev_num, inst->char_hw,
+	                                      char_dev_groups, "char_device_file%u", index);
+	if(IS_ERR(inst->dev))
+	{
+		pr_err("failed to create a device\n");
+		ret = PTR_ERR(inst->dev);
+		goto failed_create_device;
+	}
+
+	/* Register entry point with kernel */
+	inst->vcdev = cdev_alloc(); // request kernel allocate memory for cdev structure
+	if(inst->vcdev == NULL)
+	{
+		pr_err("failed to allocate cdev structure\n");
+		ret = -ENOMEM;
+		goto failed_allocate_cdev;
+	}
+
+		// initialize cdev structure and fill fops information
+	cdev_init(inst->vcdev, &fops); 
+		// register cdev structure with kernel and link to device file
+	ret = cdev_add(inst->vcdev, inst->dev_num, 1); 
+	if(ret < 0)
+	{
+		pr_err("failed to add a char device to the system\n");
+		kobject_put(&inst->vcdev->kobj);
+		goto failed_allocate_cdev;
+	}
+
+	/* Create debugfs files (optional, failures are ignored) */
+	inst->debugfs = debugfs_create_dir(dev_name(inst->dev), char_drv.debugfs);
+	debugfs_create_file("latency", 0600, inst->debugfs, inst, &char_hist_fops);
+	debugfs_create_file("clients", 0400, inst->debugfs, inst, &char_clients_fops);
+
+	return 0;
+
+failed_allocate_cdev:
+	device_destroy(char_drv.dev_class, inst->dev_num);
+
+failed_create_device:
+	char_hw_exit(inst->char_hw);
+
+failed_init_hw:
+	kfree(inst->char_hw);
+
+failed_alloc_hw:
+	free_percpu(inst->hist);
+	return ret;
+}
+
+/* Function: Destroy a device instance */
+static void char_driver_destroy_inst(char_inst_t *inst)
+{
+	/* Delete debugfs files */
+	debugfs_remove_recursive(inst->debugfs);
+
+	/* Cancel entry point registration to kernel */
+	cdev_del(inst->vcdev);
+
+	/* Delete device file */
+	device_destroy(char_drv.dev_class, inst->dev_num);
+
+	/* Cancel interrupt handling (files are closed, no request is in flight) */
+	cancel_work_sync(&inst->irq_work);
+
+	/* Release hardware device */
+	char_hw_exit(inst->char_hw);
+
+	/* Release allocated memory for driver data structure */
+	kfree(inst->char_hw);
+	free_percpu(inst->hist);
+	iput(inst->inode); // address space of mappings (no mapping is left)
+}
+
+/* Function: Initialize driver */
+static int __init char_driver_init(void)
+{
+    int ret = 0;
+	unsigned int i;
+
+	if(num_devices == 0 || num_devices > DRIVER_MAX_DEVICES)
+	{
+		pr_err("num_devices must be between 1 and %d\n", DRIVER_MAX_DEVICES);
+		return -EINVAL;
+	}
+
+	/* Allocate Device Number */
+    char_drv.dev_num = 0;
+    ret = alloc_chrdev_region(&char_drv.dev_num, 0, num_devices, "char_device"); // Find values for device numbers
+    
+	if (ret < 0)
+    {
+        pr_err("Failed to register device number dynamically\n");
+        goto failed_register_devnum;
+    }
+
+	pr_debug("allocated device number (%d, %d)\n", MAJOR(char_drv.dev_num), MINOR(char_drv.dev_num));
+
+	/* Create Device Class */
+		// create class name "class_char_device_file"
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 4, 0)
+	char_drv.dev_class = class_create("class_char_device_file");
+#else
+	char_drv.dev_class = class_create(THIS_MODULE, "class_char_device_file");
+#endif
+	if(IS_ERR(char_drv.dev_class))
+	{
+		pr_err("failed to create a device class\n");
+		ret = PTR_ERR(char_drv.dev_class);
+		goto failed_create_class;
+	}
+
+	/* Create debugfs directory of the driver */
+	char_drv.debugfs = debugfs_create_dir(KBUILD_MODNAME, NULL);
+
+	/* Create device instances */
+	char_drv.insts = kcalloc(num_devices, sizeof(char_inst_t), GFP_KERNEL);
+	if(!char_drv.insts)
+	{
+		ret = -ENOMEM;
+		goto failed_allocate_insts;
+	}
+
+	for(i = 0; i < num_devices; i++)
+	{
+		int node = numa_node[i];
+
+		// fall back to any node if the requested one has no memory
+		if(node != NUMA_NO_NODE && (node < 0 || node >= nr_node_ids || !node_state(node, N_MEMORY)))
+		{
+			pr_warn("NUMA node %d is not available for instance %u\n", node, i);
+			node = NUMA_NO_NODE;
+		}
+
+		ret = char_driver_create_inst(&char_drv.insts[i], i, node);
+		if(ret < 0)
+			goto failed_create_inst;
+		char_drv.num_insts++;
+	}
+
+	pr_debug("Initialize char driver successfully (%u devices)\n", char_drv.num_insts);
+	return 0;
+
+failed_create_inst:
+	while(char_drv.num_insts)
+		char_driver_destroy_inst(&char_drv.insts[--char_drv.num_insts]);
+	kfree(char_drv.insts);
+
+failed_allocate_insts:
+	debugfs_remove_recursive(char_drv.debugfs);
+	class_destroy(char_drv.dev_class);
+
+failed_create_class:
+	unregister_chrdev_region(char_drv.dev_num, num_devices);
+
+failed_register_devnum: 
+    return ret;
+}
+
+/* Function: Stop driver */
+static void __exit char_driver_exit(void)
+{
+	unsigned int i;
+
+	/* Destroy device instances (and their interrupt handling) */
+	for(i = 0; i < char_drv.num_insts; i++)
+		char_driver_destroy_inst(&char_drv.insts[i]);
+	kfree(char_drv.insts);
+	debugfs_remove_recursive(char_drv.debugfs);
+
+	/* Wait for releases of eventfd subscribers */
+	rcu_barrier();
+
+	/* Delete device class */
+	class_destroy(char_drv.dev_class);
+
+	/* Release device number */
+    unregister_chrdev_region(char_drv.dev_num, num_devices);
+
+	pr_debug("Exit char driver\n");
+}
+/********************************* OS SPECIFIC - END ********************************/
+
+module_init(char_driver_init);
+module_exit(char_driver_exit);
+
+MODULE_LICENSE("GPL"); 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 13, 0)
+MODULE_IMPORT_NS("DMA_BUF");
+#else
+MODULE_IMPORT_NS(DMA_BUF);
+#endif
+MODULE_AUTHOR(DRIVER_AUTHOR);
+MODULE_DESCRIPTION(DRIVER_DESC);
+MODULE_VERSION(DRIVER_VERSION);
\ No newline at end of file
@@ -0,0 +1,131 @@
+/* Tracepoints of char_driver
+	* events: char_open, char_release, char_io (read/write/mmap of data registers),
+	  char_cmd (ioctl/io_uring commands)
+	* disabled tracepoints cost one static branch, latency is only measured while a char_io/char_cmd
+	  tracepoint or the latency histograms (latency_hist module parameter) are enabled
+	* consume with ftrace (/sys/kernel/tracing/events/char_driver), perf or bpftrace
+*/
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM char_driver
+
+#if !defined(_CHAR_DRIVER_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _CHAR_DRIVER_TRACE_H
+
+#include <linux/tracepoint.h>
+
+#ifndef _CHAR_DRIVER_TRACE_OPS
+#define _CHAR_DRIVER_TRACE_OPS
+/* Operations of char_io event */
+enum char_trace_op
+{
+	CHAR_OP_READ,       // read data registers by offset
+	CHAR_OP_WRITE,      // write data registers by offset
+	CHAR_OP_FIFO_READ,  // consume data from the FIFO
+	CHAR_OP_FIFO_WRITE, // append data to the FIFO
+	CHAR_OP_MMAP,       // map data registers
+};
+#endif
+
+TRACE_DEFINE_ENUM(CHAR_OP_READ);
+TRACE_DEFINE_ENUM(CHAR_OP_WRITE);
+TRACE_DEFINE_ENUM(CHAR_OP_FIFO_READ);
+TRACE_DEFINE_ENUM(CHAR_OP_FIFO_WRITE);
+TRACE_DEFINE_ENUM(CHAR_OP_MMAP);
+
+#define show_char_op(op) __print_symbolic(op, \
+	{ CHAR_OP_READ,       "read" }, \
+	{ CHAR_OP_WRITE,      "write" }, \
+	{ CHAR_OP_FIFO_READ,  "fifo_read" }, \
+	{ CHAR_OP_FIFO_WRITE, "fifo_write" }, \
+	{ CHAR_OP_MMAP,       "mmap" })
+
+DECLARE_EVENT_CLASS(char_file_class,
+
+	TP_PROTO(unsigned int minor, unsigned int open_cnt),
+
+	TP_ARGS(minor, open_cnt),
+
+	TP_STRUCT__entry(
+		__field(unsigned int, minor)
+		__field(unsigned int, open_cnt)
+	),
+
+	TP_fast_assign(
+		__entry->minor = minor;
+		__entry->open_cnt = open_cnt;
+	),
+
+	TP_printk("minor=%u open_cnt=%u", __entry->minor, __entry->open_cnt)
+);
+
+DEFINE_EVENT(char_file_class, char_open,
+	TP_PROTO(unsigned int minor, unsigned int open_cnt),
+	TP_ARGS(minor, open_cnt)
+);
+
+DEFINE_EVENT(char_file_class, char_release,
+	TP_PROTO(unsigned int minor, unsigned int open_cnt),
+	TP_ARGS(minor, open_cnt)
+);
+
+TRACE_EVENT(char_io,
+
+	TP_PROTO(unsigned int minor, unsigned int op, loff_t offset, size_t len, ssize_t result, u64 latency_ns),
+
+	TP_ARGS(minor, op, offset, len, result, latency_ns),
+
+	TP_STRUCT__entry(
+		__field(unsigned int, minor)
+		__field(unsigned int, op)
+		__field(loff_t, offset)
+		__field(size_t, len)
+		__field(ssize_t, result)
+		__field(u64, latency_ns)
+	),
+
+	TP_fast_assign(
+		__entry->minor = minor;
+		__entry->op = op;
+		__entry->offset = offset;
+		__entry->len = len;
+		__entry->result = result;
+		__entry->latency_ns = latency_ns;
+	),
+
+	TP_printk("minor=%u op=%s offset=%lld len=%zu result=%zd latency_ns=%llu",
+		  __entry->minor, show_char_op(__entry->op), __entry->offset, __entry->len,
+		  __entry->result, __entry->latency_ns)
+);
+
+TRACE_EVENT(char_cmd,
+
+	TP_PROTO(unsigned int minor, unsigned int cmd, long result, u64 latency_ns),
+
+	TP_ARGS(minor, cmd, result, latency_ns),
+
+	TP_STRUCT__entry(
+		__field(unsigned int, minor)
+		__field(unsigned int, cmd)
+		__field(long, result)
+		__field(u64, latency_ns)
+	),
+
+	TP_fast_assign(
+		__entry->minor = minor;
+		__entry->cmd = cmd;
+		__entry->result = result;
+		__entry->latency_ns = latency_ns;
+	),
+
+	TP_printk("minor=%u cmd=0x%x nr=%u result=%ld latency_ns=%llu",
+		  __entry->minor, __entry->cmd, _IOC_NR(__entry->cmd), __entry->result, __entry->latency_ns)
+);
+
+#endif /* _CHAR_DRIVER_TRACE_H */
+
+/* This part must be outside protection */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE char_driver_trace
+#include <trace/define_trace.h>
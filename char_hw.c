@@ -0,0 +1,1710 @@
+/*
+	Register model of the virtual character device ("DEVICE SPECIFIC" part of char_driver)
+	* the kernel module builds it with char_driver_main.c (see Kbuild)
+	* user_app builds it as a user-space library on top of char_hw_compat.h,
+	  for microbenchmarks and fuzzing of the register model without loading the module
+*/
+#ifdef __KERNEL__
+#include <linux/version.h> /* Include: LINUX_VERSION_CODE */
+#include <linux/slab.h>    /* Include: kmalloc & kfree*/
+#include <linux/vmalloc.h> /* Include: vmap & vmalloc_user*/
+#include <linux/mm.h>      /* Include functions for allocating pages*/
+#include <linux/log2.h>    /* Include: order_base_2 */
+#include <linux/bitmap.h>  /* Include functions for snapshot bitmaps */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 14, 0)
+#include <linux/crc32.h>   /* Include: crc32c (CPU instructions where available) */
+#else
+#include <linux/crc32c.h>  /* Include: crc32c (CPU instructions where available) */
+#endif
+#include <linux/random.h>  /* Include: get_random_u32 (timing model jitter) */
+#include <linux/math64.h>  /* Include: mul_u64_u64_div_u64, mul_u64_u32_shr */
+#include <linux/time64.h>  /* Include: NSEC_PER_SEC */
+#endif
+
+#include "char_hw.h"       /* Include data structures of the register model */
+
+/* Backing memory of data registers */
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+#define DATA_REGS_HUGE_ORDER HPAGE_PMD_ORDER          // large regions are built from huge pages
+#else
+#define DATA_REGS_HUGE_ORDER PAGE_ALLOC_COSTLY_ORDER
+#endif
+#define DATA_REGS_CONTIG_ORDER PAGE_ALLOC_COSTLY_ORDER // small regions are one contiguous block
+#define DATA_REGS_CLEAR_CHUNK (1UL << 20)             // clear large regions chunk by chunk
+#define DATA_REGS_SCAN_CHUNK (1UL << 16)              // checksum/fill/compare lock one chunk at a time
+
+/* Locking of data registers
+	* data registers are split into stripes of 2^stripe_shift bytes (a cache line at least,
+	  a page at most), stripes share DATA_REGS_NUM_STRIPES reader/writer locks round-robin
+	* read/write lock the stripes they cover in ascending lock order, so accesses to disjoint
+	  ranges run in parallel and readers never block other readers
+	* clear and permission/mode changes lock all stripes for writing
+*/
+#define DATA_REGS_NUM_STRIPES 32
+
+/****************************** DEVICE SPECIFIC - START *****************************/
+#ifdef __KERNEL__
+/* Function: Allocate pages backing data registers
+   Parameters:
+		* hw: pointer to char device
+		* size: number of data registers
+   Note: depending on size, data registers are backed by
+		* one physically contiguous block (small regions, no vmap needed)
+		* huge pages (regions of at least one huge page, fewer TLB misses)
+		* single pages, like vmalloc (everything else, or if huge pages run out)
+*/
+static int char_hw_alloc_data(char_dev_t *hw, size_t size, int node)
+{
+	unsigned long nr_pages = PAGE_ALIGN(size) >> PAGE_SHIFT;
+	unsigned int order;
+	unsigned long i, j;
+
+	hw->data_pages = kvmalloc_node(nr_pages * sizeof(struct page *), GFP_KERNEL, node);
+	if(!hw->data_pages)
+		return -ENOMEM;
+
+	// Choose the size of blocks to allocate
+	if(nr_pages <= (1UL << DATA_REGS_CONTIG_ORDER))
+		order = get_order(size);
+	else if(nr_pages >= (1UL << DATA_REGS_HUGE_ORDER))
+		order = DATA_REGS_HUGE_ORDER;
+	else
+		order = 0;
+
+	for(i = 0; i < nr_pages; i += j)
+	{
+		struct page *page;
+
+		page = alloc_pages_node(node, GFP_KERNEL | __GFP_ZERO | (order ? __GFP_NOWARN | __GFP_NORETRY : 0), order);
+		if(!page && order)
+		{
+			// fall back to single pages if no block of this size is available
+			order = 0;
+			j = 0;
+			continue;
+		}
+		if(!page)
+			goto failed_alloc_page;
+
+		// Every page gets its own reference count, so it can be mapped
+		// into user space and the unused tail of a block can be freed
+		split_page(page, order);
+		for(j = 0; j < (1UL << order); j++)
+		{
+			if(i + j < nr_pages)
+				hw->data_pages[i + j] = page + j;
+			else
+				__free_page(page + j);
+		}
+		cond_resched();
+	}
+	hw->nr_data_pages = nr_pages;
+
+	// Get a contiguous kernel address for data registers
+	if(nr_pages <= (1UL << order))
+	{
+		hw->data_regs = page_address(hw->data_pages[0]);
+		hw->data_vmapped = false;
+	}
+	else
+	{
+		hw->data_regs = vmap(hw->data_pages, nr_pages, VM_MAP | VM_USERMAP, PAGE_KERNEL);
+		if(!hw->data_regs)
+			goto failed_alloc_page;
+		hw->data_vmapped = true;
+	}
+
+	hw->data_size = size;
+	return 0;
+
+failed_alloc_page:
+	while(i--)
+		__free_page(hw->data_pages[i]);
+	kvfree(hw->data_pages);
+	return -ENOMEM;
+}
+
+/* Function: Release pages backing data registers */
+static void char_hw_free_data(char_dev_t *hw)
+{
+	unsigned long i;
+
+	if(hw->data_vmapped)
+		vunmap(hw->data_regs);
+	for(i = 0; i < hw->nr_data_pages; i++)
+		__free_page(hw->data_pages[i]);
+	kvfree(hw->data_pages);
+}
+#else /* !__KERNEL__ */
+/* Function: Allocate data registers (user space: one zeroed page-aligned block) */
+static int char_hw_alloc_data(char_dev_t *hw, size_t size, int node)
+{
+	hw->data_regs = vmalloc_user(size);
+	if(!hw->data_regs)
+		return -ENOMEM;
+
+	hw->data_pages = NULL;
+	hw->nr_data_pages = 0;
+	hw->data_vmapped = false;
+	hw->data_size = size;
+	return 0;
+}
+
+/* Function: Release data registers */
+static void char_hw_free_data(char_dev_t *hw)
+{
+	vfree(hw->data_regs);
+}
+#endif /* __KERNEL__ */
+
+/* Lock classes of stripes, each lock gets its own class as several are held at once */
+static struct lock_class_key char_hw_stripe_keys[DATA_REGS_NUM_STRIPES];
+
+/* Function: Initialize device
+   Parameters:
+		* hw: pointer to char device
+		* size: number of data registers
+		* dirty_shift: size of chunks of dirty tracking (log2)
+		* node: NUMA node to allocate registers on (NUMA_NO_NODE: any node)
+*/
+int char_hw_init(char_dev_t *hw, size_t size, unsigned int dirty_shift, int node)
+{
+	// Initialize buffer for control & status registers
+	char* buf;
+	int i;
+
+	if(size == 0)
+		return -EINVAL;
+
+	buf = kzalloc_node((NUM_CTRL_REGS + NUM_STS_REGS) * REG_SIZE, GFP_KERNEL, node);
+	if(!buf)
+		return -ENOMEM;
+
+	hw->control_regs = buf;
+	hw->status_regs = hw->control_regs + NUM_CTRL_REGS;
+
+	// Initialize buffer for data registers
+		// Data registers live on their own zeroed pages, so they can be mapped
+		// into user space without exposing the control/status registers
+	if(char_hw_alloc_data(hw, size, node) < 0)
+		goto failed_alloc_data;
+
+	// Initialize statistics counters
+	hw->stats = alloc_percpu(char_pcpu_stats_t);
+	if(!hw->stats)
+		goto failed_alloc_stats;
+	for_each_possible_cpu(i)
+		u64_stats_init(&per_cpu_ptr(hw->stats, i)->syncp);
+
+	// Initialize locks
+	hw->stripes = kzalloc_node(DATA_REGS_NUM_STRIPES * sizeof(*hw->stripes), GFP_KERNEL, node);
+	if(!hw->stripes)
+		goto failed_alloc_stripes;
+	for(i = 0; i < DATA_REGS_NUM_STRIPES; i++)
+		__init_rwsem(&hw->stripes[i].sem, "char_hw_stripe", &char_hw_stripe_keys[i]);
+	hw->stripe_shift = clamp_t(unsigned int, order_base_2(DIV_ROUND_UP(size, DATA_REGS_NUM_STRIPES)),
+	                           L1_CACHE_SHIFT, PAGE_SHIFT);
+	seqlock_init(&hw->reg_seq);
+	mutex_init(&hw->fifo_lock);
+	spin_lock_init(&hw->model.lock);
+
+	// Initialize dirty tracking (epoch 0 means "everything", so counting starts at 1)
+	hw->dirty_shift = clamp_t(unsigned int, dirty_shift, L1_CACHE_SHIFT, PAGE_SHIFT);
+	hw->nr_dirty_chunks = DIV_ROUND_UP(size, 1UL << hw->dirty_shift);
+	hw->dirty_gens = kvzalloc_node(hw->nr_dirty_chunks * sizeof(u64), GFP_KERNEL, node);
+	if(!hw->dirty_gens)
+		goto failed_alloc_dirty;
+	atomic64_set(&hw->dirty_epoch, 1);
+	atomic_set(&hw->wr_mappings, 0);
+
+	// Initialize data for registers
+	hw->control_regs[CONTROL_ACCESS_REG] = 0x03;
+	hw->status_regs[DEVICE_STATUS_REG] = 0x03;
+
+	return 0;
+
+failed_alloc_dirty:
+	kfree(hw->stripes);
+
+failed_alloc_stripes:
+	free_percpu(hw->stats);
+
+failed_alloc_stats:
+	char_hw_free_data(hw);
+
+failed_alloc_data:
+	kfree(buf);
+	return -ENOMEM;
+}
+
+/* Function: Release device */
+void char_hw_exit(char_dev_t *hw)
+{
+	kvfree(hw->dirty_gens);
+	kfree(hw->stripes);
+	free_percpu(hw->stats);
+	char_hw_free_data(hw);
+	kfree(hw->control_regs);
+}
+
+/* Function: Report events to the owner of the device, if it asked for them */
+static inline void char_hw_notify(char_dev_t *hw, unsigned int events)
+{
+	if(READ_ONCE(hw->notify_events) & events)
+		hw->notify(hw, events);
+}
+
+/* Function: Set the notifier of events (before the device is used)
+   Parameters:
+		* hw: pointer to char device
+		* notify: function called with CHAR_HW_EV_* events
+		* data: data of notifier (hw->notify_data)
+*/
+void char_hw_set_notify(char_dev_t *hw, char_hw_notify_t notify, void *data)
+{
+	hw->notify = notify;
+	hw->notify_data = data;
+}
+
+/* Function: Select CHAR_HW_EV_* events to report (0: none, no cost to operations) */
+void char_hw_set_notify_events(char_dev_t *hw, unsigned int events)
+{
+	WRITE_ONCE(hw->notify_events, hw->notify ? events : 0);
+}
+
+/* Function: Configure the timing model
+   Parameters:
+		* hw: pointer to char device
+		* latency_ns: latency of each operation
+		* bandwidth: transfer rate in bytes per second (0: unlimited)
+		* jitter_ns: random extra latency of each operation, up to jitter_ns
+*/
+void char_hw_set_model(char_dev_t *hw, u64 latency_ns, u64 bandwidth, u64 jitter_ns)
+{
+	WRITE_ONCE(hw->model.latency_ns, latency_ns);
+	WRITE_ONCE(hw->model.bandwidth, bandwidth);
+	WRITE_ONCE(hw->model.jitter_ns, jitter_ns);
+}
+
+/* Function: Time when the device completes an operation, in the timing model
+   Parameters:
+		* hw: pointer to char device
+		* now_ns: time when the operation is issued (monotonic clock)
+		* bytes: number of registers transferred
+   Return: completion time (monotonic clock)
+   Note: transfers are serialized at the bandwidth, latencies of operations overlap
+		 (the device pipelines them), jitter may complete operations out of order
+*/
+u64 char_hw_model_complete(char_dev_t *hw, u64 now_ns, size_t bytes)
+{
+	u64 bandwidth = READ_ONCE(hw->model.bandwidth);
+	u64 jitter_ns = READ_ONCE(hw->model.jitter_ns);
+	u64 done_ns = now_ns;
+
+	// Transfer after the transfers issued before
+	if(bandwidth)
+	{
+		spin_lock(&hw->model.lock);
+		done_ns = max_t(u64, now_ns, hw->model.busy_ns) + mul_u64_u64_div_u64(bytes, NSEC_PER_SEC, bandwidth);
+		hw->model.busy_ns = done_ns;
+		spin_unlock(&hw->model.lock);
+	}
+
+	done_ns += READ_ONCE(hw->model.latency_ns);
+	if(jitter_ns)
+		done_ns += mul_u64_u32_shr(jitter_ns, get_random_u32(), 32);
+	return done_ns;
+}
+
+/* Functions: Update statistics counters of the local CPU */
+void char_hw_count_read(char_dev_t *hw, size_t bytes)
+{
+	char_pcpu_stats_t *s = get_cpu_ptr(hw->stats);
+	u64 ops;
+
+	u64_stats_update_begin(&s->syncp);
+	s->cnt.read_ops++;
+	s->cnt.read_bytes += bytes;
+	u64_stats_update_end(&s->syncp);
+	ops = s->cnt.read_ops + s->cnt.write_ops;
+	put_cpu_ptr(hw->stats);
+
+	if(ops % CHAR_HW_COUNT_PERIOD == 0)
+		char_hw_notify(hw, CHAR_HW_EV_COUNT);
+}
+
+void char_hw_count_write(char_dev_t *hw, size_t bytes)
+{
+	char_pcpu_stats_t *s = get_cpu_ptr(hw->stats);
+	u64 ops;
+
+	u64_stats_update_begin(&s->syncp);
+	s->cnt.write_ops++;
+	s->cnt.write_bytes += bytes;
+	u64_stats_update_end(&s->syncp);
+	ops = s->cnt.read_ops + s->cnt.write_ops;
+	put_cpu_ptr(hw->stats);
+
+	if(ops % CHAR_HW_COUNT_PERIOD == 0)
+		char_hw_notify(hw, CHAR_HW_EV_COUNT);
+}
+
+static void char_hw_count_error(char_dev_t *hw)
+{
+	char_pcpu_stats_t *s = get_cpu_ptr(hw->stats);
+
+	u64_stats_update_begin(&s->syncp);
+	s->cnt.errors++;
+	u64_stats_update_end(&s->syncp);
+	put_cpu_ptr(hw->stats);
+}
+
+static void char_hw_count_overflow(char_dev_t *hw)
+{
+	char_pcpu_stats_t *s = get_cpu_ptr(hw->stats);
+
+	u64_stats_update_begin(&s->syncp);
+	s->cnt.overflows++;
+	u64_stats_update_end(&s->syncp);
+	put_cpu_ptr(hw->stats);
+}
+
+/* Function: Sum statistics counters of all CPUs (lockless, never delays counting CPUs) */
+void char_hw_get_stats(char_dev_t *hw, char_stats_t *stats)
+{
+	int cpu;
+
+	memset(stats, 0, sizeof(*stats));
+	for_each_possible_cpu(cpu)
+	{
+		char_pcpu_stats_t *s = per_cpu_ptr(hw->stats, cpu);
+		char_stats_t cnt;
+		unsigned int start;
+
+		// retry if the CPU updated its counters meanwhile (only on 32-bit CPUs)
+		do
+		{
+			start = u64_stats_fetch_begin(&s->syncp);
+			cnt = s->cnt;
+		} while(u64_stats_fetch_retry(&s->syncp, start));
+
+		stats->read_ops += cnt.read_ops;
+		stats->write_ops += cnt.write_ops;
+		stats->read_bytes += cnt.read_bytes;
+		stats->write_bytes += cnt.write_bytes;
+		stats->errors += cnt.errors;
+		stats->overflows += cnt.overflows;
+	}
+}
+
+/* Functions: Lock/unlock stripes covering data registers [start_reg, start_reg + num_regs) */
+static void char_hw_lock_stripes(char_dev_t *hw, unsigned int first, unsigned int last, bool write)
+{
+	unsigned int i;
+
+	for(i = first; i <= last; i++)
+	{
+		if(write)
+			down_write(&hw->stripes[i].sem);
+		else
+			down_read(&hw->stripes[i].sem);
+	}
+}
+
+static void char_hw_unlock_stripes(char_dev_t *hw, unsigned int first, unsigned int last, bool write)
+{
+	unsigned int i;
+
+	for(i = first; i <= last; i++)
+	{
+		if(write)
+			up_write(&hw->stripes[i].sem);
+		else
+			up_read(&hw->stripes[i].sem);
+	}
+}
+
+static void char_hw_lock_range(char_dev_t *hw, loff_t start_reg, size_t num_regs, bool write)
+{
+	unsigned long first, last;
+
+	if(num_regs == 0)
+		return;
+
+	first = start_reg >> hw->stripe_shift;
+	last = (start_reg + num_regs - 1) >> hw->stripe_shift;
+	if(last - first >= DATA_REGS_NUM_STRIPES - 1)
+	{
+		// range covers every lock
+		char_hw_lock_stripes(hw, 0, DATA_REGS_NUM_STRIPES - 1, write);
+		return;
+	}
+
+	first %= DATA_REGS_NUM_STRIPES;
+	last %= DATA_REGS_NUM_STRIPES;
+	if(first <= last)
+		char_hw_lock_stripes(hw, first, last, write);
+	else
+	{
+		// range wraps around the lock array, still lock in ascending order
+		char_hw_lock_stripes(hw, 0, last, write);
+		char_hw_lock_stripes(hw, first, DATA_REGS_NUM_STRIPES - 1, write);
+	}
+}
+
+static void char_hw_unlock_range(char_dev_t *hw, loff_t start_reg, size_t num_regs, bool write)
+{
+	unsigned long first, last;
+
+	if(num_regs == 0)
+		return;
+
+	first = start_reg >> hw->stripe_shift;
+	last = (start_reg + num_regs - 1) >> hw->stripe_shift;
+	if(last - first >= DATA_REGS_NUM_STRIPES - 1)
+	{
+		char_hw_unlock_stripes(hw, 0, DATA_REGS_NUM_STRIPES - 1, write);
+		return;
+	}
+
+	first %= DATA_REGS_NUM_STRIPES;
+	last %= DATA_REGS_NUM_STRIPES;
+	if(first <= last)
+		char_hw_unlock_stripes(hw, first, last, write);
+	else
+	{
+		char_hw_unlock_stripes(hw, 0, last, write);
+		char_hw_unlock_stripes(hw, first, DATA_REGS_NUM_STRIPES - 1, write);
+	}
+}
+
+/* Functions: Lock/unlock all data registers (no read/write in flight) */
+static void char_hw_lock_all(char_dev_t *hw)
+{
+	char_hw_lock_stripes(hw, 0, DATA_REGS_NUM_STRIPES - 1, true);
+}
+
+static void char_hw_unlock_all(char_dev_t *hw)
+{
+	char_hw_unlock_stripes(hw, 0, DATA_REGS_NUM_STRIPES - 1, true);
+}
+
+/* Functions: Lock/unlock the whole device (no read/write of any mode in flight)
+   Note: while the device is locked, only the __char_hw_* functions may be used
+*/
+void char_hw_lock_device(char_dev_t *hw)
+{
+	mutex_lock(&hw->fifo_lock);
+	char_hw_lock_all(hw);
+}
+
+void char_hw_unlock_device(char_dev_t *hw)
+{
+	char_hw_unlock_all(hw);
+	mutex_unlock(&hw->fifo_lock);
+}
+
+/* Function: Mark data registers [start_reg, start_reg + num_regs) as written in the current epoch
+   Note: called with the registers locked for writing (or the FIFO locked),
+		 so a dirty lookup sees either old data and old epoch, or the new ones
+*/
+static void char_hw_mark_dirty(char_dev_t *hw, loff_t start_reg, size_t num_regs)
+{
+	u64 epoch = atomic64_read(&hw->dirty_epoch);
+	unsigned long i, last;
+
+	if(num_regs == 0)
+		return;
+
+	last = (start_reg + num_regs - 1) >> hw->dirty_shift;
+	for(i = start_reg >> hw->dirty_shift; i <= last; i++)
+	{
+		// do not dirty cache lines of chunks already marked in this epoch
+		if(hw->dirty_gens[i] != epoch)
+			WRITE_ONCE(hw->dirty_gens[i], epoch);
+	}
+}
+
+/* Function: Copy stripes of [start_reg, start_reg + num_regs) into the snapshot before they change
+   Note: called with the registers locked for writing, once per stripe the copy is taken
+		 by the first writer, so a snapshot costs nothing to writers of unchanged stripes
+*/
+static void __char_hw_snap_save(char_dev_t *hw, loff_t start_reg, size_t num_regs)
+{
+	char_snap_t *snap = hw->snap;
+	unsigned long i, last;
+	size_t off;
+
+	if(!snap || num_regs == 0)
+		return;
+
+	last = (start_reg + num_regs - 1) >> hw->stripe_shift;
+	for(i = start_reg >> hw->stripe_shift; i <= last; i++)
+	{
+		if(test_bit(i, snap->saved))
+			continue;
+		off = i << hw->stripe_shift;
+		memcpy(snap->data_regs + off, hw->data_regs + off, min_t(size_t, 1UL << hw->stripe_shift, hw->data_size - off));
+		set_bit(i, snap->saved);
+	}
+}
+
+/* Functions: Account a finished read/write in statistics counters */
+static void char_hw_account_read(char_dev_t *hw, ssize_t result)
+{
+	if(result < 0)
+		char_hw_count_error(hw);
+	else
+		char_hw_count_read(hw, result); // Update reading data time
+}
+
+static void char_hw_account_write(char_dev_t *hw, ssize_t result)
+{
+	if(result < 0)
+		char_hw_count_error(hw);
+	else
+		char_hw_count_write(hw, result); // Update writing data time
+}
+
+/* Function: Report a write truncated at the end of data registers */
+static void char_hw_overflow(char_dev_t *hw)
+{
+	unsigned char old_status;
+
+	write_seqlock(&hw->reg_seq);
+	old_status = hw->status_regs[DEVICE_STATUS_REG];
+	hw->status_regs[DEVICE_STATUS_REG] |= STS_DATAREGS_OVERFLOW_BIT;
+	write_sequnlock(&hw->reg_seq);
+	char_hw_count_overflow(hw);
+	if(!(old_status & STS_DATAREGS_OVERFLOW_BIT))
+		char_hw_notify(hw, CHAR_HW_EV_OVERFLOW);
+}
+
+/* Function: Number of registers in [start_reg, start_reg + num_regs) inside data registers */
+static ssize_t char_hw_clamp_range(char_dev_t *hw, loff_t start_reg, size_t num_regs)
+{
+	// Check for the validity of registers position
+	if(start_reg < 0)
+		return -EINVAL;
+
+	// Nothing at or after the end of data registers
+	if(start_reg >= hw->data_size)
+		return 0;
+
+	// Adjust the number of register(if necessary)
+	return min_t(size_t, num_regs, hw->data_size - start_reg);
+}
+
+/* Function: Start reading data from registers of a locked device (see char_hw_read_begin) */
+ssize_t __char_hw_read_begin(char_dev_t *hw, loff_t start_reg, size_t num_regs, unsigned char **regs)
+{
+	ssize_t read_bytes = char_hw_clamp_range(hw, start_reg, num_regs);
+
+	// Check for reading data permission
+	if(read_bytes >= 0 && (READ_ONCE(hw->control_regs[CONTROL_ACCESS_REG]) & CTRL_READ_DATA_BIT) == DISABLE)
+		read_bytes = -EPERM;
+
+	if(read_bytes < 0)
+	{
+		char_hw_count_error(hw);
+		return read_bytes;
+	}
+
+	*regs = hw->data_regs + start_reg;
+	return read_bytes;
+}
+
+/* Function: Finish reading data from registers of a locked device */
+void __char_hw_read_end(char_dev_t *hw, ssize_t result)
+{
+	char_hw_account_read(hw, result);
+}
+
+/* Function: Start reading data from registers of device
+   Parameters:
+		* hw: pointer to char device
+   		* start_reg: start reading data register
+		* num_regs: number of register to read
+		* regs: returns address of the first register to read
+   Return: number of registers which can be read, or negative error code
+   Note: the registers stay locked for reading while the caller copies data out of *regs,
+		 then the caller calls char_hw_read_end() with the returned number of registers
+*/
+ssize_t char_hw_read_begin(char_dev_t *hw, loff_t start_reg, size_t num_regs, unsigned char **regs)
+{
+	ssize_t read_bytes = char_hw_clamp_range(hw, start_reg, num_regs);
+	ssize_t locked = read_bytes;
+
+	if(read_bytes < 0)
+	{
+		char_hw_count_error(hw);
+		return read_bytes;
+	}
+
+	// Permission is checked once registers are locked (permission changes wait for them)
+	char_hw_lock_range(hw, start_reg, locked, false);
+	read_bytes = __char_hw_read_begin(hw, start_reg, num_regs, regs);
+	if(read_bytes < 0)
+		char_hw_unlock_range(hw, start_reg, locked, false);
+
+	return read_bytes;
+}
+
+/* Function: Finish reading data from registers of device
+   Parameters:
+		* hw: pointer to char device
+		* start_reg: start reading data register
+		* num_regs: number of register returned by char_hw_read_begin()
+		* result: number of registers actually read, or negative error code
+*/
+void char_hw_read_end(char_dev_t *hw, loff_t start_reg, size_t num_regs, ssize_t result)
+{
+	char_hw_unlock_range(hw, start_reg, num_regs, false);
+	__char_hw_read_end(hw, result);
+}
+
+/* Function: Start writing data to registers of a locked device (see char_hw_write_begin) */
+ssize_t __char_hw_write_begin(char_dev_t *hw, loff_t start_reg, size_t num_regs, unsigned char **regs)
+{
+	ssize_t write_bytes = char_hw_clamp_range(hw, start_reg, num_regs);
+
+	// Check for writing data permission
+	if(write_bytes >= 0 && (READ_ONCE(hw->control_regs[CONTROL_ACCESS_REG]) & CTRL_WRITE_DATA_BIT) == DISABLE)
+		write_bytes = -EPERM;
+
+	if(write_bytes < 0)
+	{
+		char_hw_count_error(hw);
+		return write_bytes;
+	}
+
+	// Not all registers fit until the end of data registers
+	if(write_bytes < num_regs)
+	{
+		char_hw_overflow(hw);
+
+		// writing at the end of data registers cannot make progress
+		if(write_bytes == 0)
+			return -ENOSPC;
+	}
+
+	// A failed copy leaves the registers marked, which only costs a useless transfer
+	char_hw_mark_dirty(hw, start_reg, write_bytes);
+	__char_hw_snap_save(hw, start_reg, write_bytes);
+	*regs = hw->data_regs + start_reg;
+	return write_bytes;
+}
+
+/* Function: Finish writing data to registers of a locked device */
+void __char_hw_write_end(char_dev_t *hw, ssize_t result)
+{
+	char_hw_account_write(hw, result);
+}
+
+/* Function: Start writing data to registers of device
+   Parameters:
+		* hw: pointer to char device
+   		* start_reg: start writing data register
+		* num_regs: number of register to write
+		* regs: returns address of the first register to write
+   Return: number of registers which can be written, or negative error code
+   Note: the registers stay locked for writing while the caller copies data into *regs,
+		 then the caller calls char_hw_write_end() with the returned number of registers
+*/
+ssize_t char_hw_write_begin(char_dev_t *hw, loff_t start_reg, size_t num_regs, unsigned char **regs)
+{
+	ssize_t write_bytes = char_hw_clamp_range(hw, start_reg, num_regs);
+	ssize_t locked = write_bytes;
+
+	if(write_bytes < 0)
+	{
+		char_hw_count_error(hw);
+		return write_bytes;
+	}
+
+	// Permission is checked once registers are locked (permission changes wait for them)
+	char_hw_lock_range(hw, start_reg, locked, true);
+	write_bytes = __char_hw_write_begin(hw, start_reg, num_regs, regs);
+	if(write_bytes < 0)
+		char_hw_unlock_range(hw, start_reg, locked, true);
+
+	return write_bytes;
+}
+
+/* Function: Finish writing data to registers of device
+   Parameters:
+		* hw: pointer to char device
+		* start_reg: start writing data register
+		* num_regs: number of register returned by char_hw_write_begin()
+		* result: number of registers actually written, or negative error code
+*/
+void char_hw_write_end(char_dev_t *hw, loff_t start_reg, size_t num_regs, ssize_t result)
+{
+	char_hw_unlock_range(hw, start_reg, num_regs, true);
+	__char_hw_write_end(hw, result);
+}
+
+/* Function: Read data from registers of device 
+   Parameters:
+		* hw: pointer to char device
+   		* start_reg: start reading data register
+		* num_regs: number of register to read
+		* kbuf: address of kernel buffer
+*/
+ssize_t char_hw_read_data(char_dev_t *hw, loff_t start_reg, size_t num_regs, char* kbuf)
+{
+	unsigned char *regs;
+	ssize_t read_bytes;
+
+	// Check for the validity of kernel buffer address
+	if(kbuf == NULL)
+		return -EINVAL;
+
+	read_bytes = char_hw_read_begin(hw, start_reg, num_regs, &regs);
+	if(read_bytes < 0)
+		return read_bytes;
+
+	// Read data from registers to kernel buffer
+		// Because this is the virtual device on RAM, we just use 
+		// memcpy function to read data of character device
+	memcpy(kbuf, regs, read_bytes);
+	char_hw_read_end(hw, start_reg, read_bytes, read_bytes);
+
+	// Return read byte number
+	return read_bytes;
+}
+
+/* Function: Write data to registers of device 
+   Parameters:
+		* hw: pointer to char device
+   		* start_reg: start writing data register
+		* num_regs: number of register to write
+		* kbuf: address of kernel buffer
+*/
+ssize_t char_hw_write_data(char_dev_t *hw, loff_t start_reg, size_t num_regs, char* kbuf)
+{
+	unsigned char *regs;
+	ssize_t write_bytes;
+
+	// Check for the validity of kernel buffer address
+	if(kbuf == NULL)
+		return -EINVAL;
+
+	write_bytes = char_hw_write_begin(hw, start_reg, num_regs, &regs);
+	if(write_bytes < 0)
+		return write_bytes;
+
+	// Write data from kernel buffer to register
+		// Because this is the virtual device on RAM, we just use 
+		// memcpy function to write data to character device
+	memcpy(regs, kbuf, write_bytes);
+	char_hw_write_end(hw, start_reg, write_bytes, write_bytes);
+
+	// Return write byte number
+	return write_bytes;
+}
+
+/* Function: Clear data on registers of a locked device */
+int __char_hw_clear_data(char_dev_t *hw)
+{
+	size_t off;
+
+	if((hw->control_regs[CONTROL_ACCESS_REG] & CTRL_WRITE_DATA_BIT) == DISABLE)
+		return -EPERM;
+
+	// Remove data on registers (chunk by chunk, large regions take a while)
+	__char_hw_snap_save(hw, 0, hw->data_size);
+	for(off = 0; off < hw->data_size; off += DATA_REGS_CLEAR_CHUNK)
+	{
+		memset(hw->data_regs + off, 0, min_t(size_t, DATA_REGS_CLEAR_CHUNK, hw->data_size - off));
+		cond_resched();
+	}
+	char_hw_mark_dirty(hw, 0, hw->data_size);
+	write_seqlock(&hw->reg_seq);
+	hw->status_regs[DEVICE_STATUS_REG] &= ~STS_DATAREGS_OVERFLOW_BIT; // Delete overflow bit status
+	write_sequnlock(&hw->reg_seq);
+
+	// Empty the FIFO
+	hw->fifo_head = 0;
+	hw->fifo_tail = 0;
+
+	char_hw_notify(hw, CHAR_HW_EV_CLEAR);
+	return 0;
+}
+
+/* Function: Clear data on registers */
+int char_hw_clear_data(char_dev_t *hw)
+{
+	int ret;
+
+	char_hw_lock_device(hw);
+	ret = __char_hw_clear_data(hw);
+	char_hw_unlock_device(hw);
+
+	return ret;
+}
+
+/*
+	Checksum, fill and compare work on ranges of any size without a copy to user space:
+	they lock DATA_REGS_SCAN_CHUNK registers at a time, so other accesses wait for one chunk
+	at most, and a range changed meanwhile is seen partly old, partly new (like by several
+	reads; take a snapshot for a consistent view). Each call counts as one read/write.
+*/
+
+/* Function: Check a range and permission before a scan (chunks check permission again)
+   Return: 0, or negative value if the scan is rejected (error counted)
+*/
+static int char_hw_scan_check(char_dev_t *hw, ssize_t total, unsigned char ctrl_bit)
+{
+	if(total >= 0 && (READ_ONCE(hw->control_regs[CONTROL_ACCESS_REG]) & ctrl_bit) != DISABLE)
+		return 0;
+
+	char_hw_count_error(hw);
+	return -1;
+}
+
+/* Function: Compute CRC32C of data registers
+   Parameters:
+		* hw: pointer to char device
+   		* start_reg: start data register
+		* num_regs: number of registers
+		* crc: CRC32C of preceding data (kernel convention, no inversion), returns: CRC32C of the range
+   Return: number of registers checksummed, or negative error code
+*/
+ssize_t char_hw_crc32c(char_dev_t *hw, loff_t start_reg, size_t num_regs, u32 *crc)
+{
+	ssize_t total = char_hw_clamp_range(hw, start_reg, num_regs);
+	unsigned char *regs;
+	ssize_t done, n;
+
+	if(char_hw_scan_check(hw, total, CTRL_READ_DATA_BIT) < 0)
+		return total < 0 ? total : -EPERM;
+
+	for(done = 0; done < total; done += n)
+	{
+		n = char_hw_read_begin(hw, start_reg + done, min_t(size_t, DATA_REGS_SCAN_CHUNK, total - done), &regs);
+		if(n < 0 && done == 0)
+			return n;
+		if(n < 0)
+			break; // permission changed meanwhile (error counted)
+		*crc = crc32c(*crc, regs, n);
+		char_hw_unlock_range(hw, start_reg + done, n, false);
+		cond_resched();
+	}
+
+	char_hw_account_read(hw, done);
+	return done;
+}
+
+/* Function: Fill registers with a pattern in registers */
+static void char_hw_fill_pattern(unsigned char *regs, size_t num_regs, const unsigned char *pattern,
+                                 size_t pattern_len, size_t phase)
+{
+	size_t i, len;
+
+	if(pattern_len == 1)
+	{
+		memset(regs, pattern[0], num_regs);
+		return;
+	}
+
+	// write one period of the pattern, then double it (copies keep whole periods)
+	len = min_t(size_t, num_regs, pattern_len);
+	for(i = 0; i < len; i++)
+		regs[i] = pattern[(phase + i) % pattern_len];
+	while(len < num_regs)
+	{
+		i = min_t(size_t, len, num_regs - len);
+		memcpy(regs + len, regs, i);
+		len += i;
+	}
+}
+
+/* Function: Fill data registers with a repeated pattern
+   Parameters:
+		* hw: pointer to char device
+   		* start_reg: start data register
+		* num_regs: number of registers
+		* pattern: pattern (register start_reg gets its first byte)
+		* pattern_len: size of pattern
+   Return: number of registers filled, or negative error code
+   Note: like a write, a range exceeding data registers is truncated and sets the overflow bit
+*/
+ssize_t char_hw_fill_data(char_dev_t *hw, loff_t start_reg, size_t num_regs, const unsigned char *pattern, size_t pattern_len)
+{
+	ssize_t total = char_hw_clamp_range(hw, start_reg, num_regs);
+	unsigned char *regs;
+	ssize_t done, n;
+
+	if(pattern_len == 0)
+		return -EINVAL;
+	if(char_hw_scan_check(hw, total, CTRL_WRITE_DATA_BIT) < 0)
+		return total < 0 ? total : -EPERM;
+
+	for(done = 0; done < total; done += n)
+	{
+		n = char_hw_write_begin(hw, start_reg + done, min_t(size_t, DATA_REGS_SCAN_CHUNK, total - done), &regs);
+		if(n < 0 && done == 0)
+			return n;
+		if(n < 0)
+			break; // permission changed meanwhile (error counted)
+		char_hw_fill_pattern(regs, n, pattern, pattern_len, done % pattern_len);
+		char_hw_unlock_range(hw, start_reg + done, n, true);
+		cond_resched();
+	}
+
+	// Not all registers fit until the end of data registers
+	if(done == total && total < num_regs)
+	{
+		char_hw_overflow(hw);
+		if(total == 0)
+			return -ENOSPC;
+	}
+
+	char_hw_account_write(hw, done);
+	return done;
+}
+
+/* Function: Compare data registers with a buffer
+   Parameters:
+		* hw: pointer to char device
+   		* start_reg: start data register
+		* num_regs: number of registers
+		* kbuf: address of kernel buffer
+		* mismatch: returns index of the first register differing from kbuf
+					(number of registers compared if all are equal)
+   Return: number of registers compared (until the first mismatch), or negative error code
+*/
+ssize_t char_hw_compare_data(char_dev_t *hw, loff_t start_reg, size_t num_regs, const char *kbuf, size_t *mismatch)
+{
+	ssize_t total = char_hw_clamp_range(hw, start_reg, num_regs);
+	unsigned char *regs;
+	ssize_t done, n;
+	size_t i;
+
+	*mismatch = 0;
+	if(char_hw_scan_check(hw, total, CTRL_READ_DATA_BIT) < 0)
+		return total < 0 ? total : -EPERM;
+
+	for(done = 0; done < total; done += n)
+	{
+		n = char_hw_read_begin(hw, start_reg + done, min_t(size_t, DATA_REGS_SCAN_CHUNK, total - done), &regs);
+		if(n < 0 && done == 0)
+			return n;
+		if(n < 0)
+			break; // permission changed meanwhile (error counted)
+
+		// memcmp() finds a difference fast, then look for its position
+		if(memcmp(regs, kbuf + done, n))
+		{
+			for(i = 0; regs[i] == (unsigned char)kbuf[done + i]; i++)
+				;
+			char_hw_unlock_range(hw, start_reg + done, n, false);
+			done += i;
+			*mismatch = done;
+			char_hw_account_read(hw, done);
+			return done;
+		}
+		char_hw_unlock_range(hw, start_reg + done, n, false);
+		cond_resched();
+	}
+
+	*mismatch = done;
+	char_hw_account_read(hw, done);
+	return done;
+}
+
+/* Function: New value of a register for an atomic operation
+   Return: true if the new value is to be stored
+*/
+static bool char_hw_atomic_new(unsigned int op, u64 old, u64 operand, u64 expected, u64 *new)
+{
+	switch(op)
+	{
+		case CHAR_HW_ATOMIC_ADD:
+			*new = old + operand;
+			return true;
+		case CHAR_HW_ATOMIC_CAS:
+			*new = operand;
+			return old == expected;
+		case CHAR_HW_ATOMIC_XCHG:
+			*new = operand;
+			return true;
+		case CHAR_HW_ATOMIC_AND:
+			*new = old & operand;
+			return true;
+		default:
+			*new = old | operand;
+			return true;
+	}
+}
+
+/* Function: Atomic read-modify-write of a 1/2/4-byte register through its aligned 32-bit word
+		(cmpxchg of single bytes/halfwords is not available on every architecture)
+*/
+static u64 char_hw_atomic32(unsigned char *regs, unsigned int size, unsigned int op, u64 operand, u64 expected)
+{
+	u32 *word = (u32 *)((unsigned long)regs & ~3UL);
+	unsigned int off = (unsigned long)regs & 3;
+	u32 old_word, new_word;
+	u64 old = 0, new;
+	u16 val16;
+	u8 val8;
+
+	do
+	{
+		old_word = READ_ONCE(*word);
+		new_word = old_word;
+
+		// registers keep host byte order, whatever the position in the word
+		if(size == 1)
+		{
+			memcpy(&val8, (u8 *)&old_word + off, 1);
+			old = val8;
+		}
+		else if(size == 2)
+		{
+			memcpy(&val16, (u8 *)&old_word + off, 2);
+			old = val16;
+		}
+		else
+			old = old_word;
+
+		if(!char_hw_atomic_new(op, old, operand, expected, &new))
+			break;
+
+		if(size == 1)
+		{
+			val8 = new;
+			memcpy((u8 *)&new_word + off, &val8, 1);
+		}
+		else if(size == 2)
+		{
+			val16 = new;
+			memcpy((u8 *)&new_word + off, &val16, 2);
+		}
+		else
+			new_word = new;
+	} while(cmpxchg(word, old_word, new_word) != old_word);
+
+	return old;
+}
+
+/* Function: Atomic read-modify-write of an 8-byte register */
+static u64 char_hw_atomic64(unsigned char *regs, unsigned int op, u64 operand, u64 expected)
+{
+	u64 *word = (u64 *)regs;
+	u64 old, new;
+
+	do
+	{
+		old = READ_ONCE(*word);
+		if(!char_hw_atomic_new(op, old, operand, expected, &new))
+			break;
+	} while(cmpxchg64(word, old, new) != old);
+
+	return old;
+}
+
+/* Function: Atomic read-modify-write operation on a data register
+   Parameters:
+		* hw: pointer to char device
+   		* reg: data register (aligned to size)
+		* size: size of register: 1, 2, 4 or 8 bytes (host byte order)
+		* op: CHAR_HW_ATOMIC_* operation
+		* operand: operand of operation
+		* expected: CHAR_HW_ATOMIC_CAS: value the register must hold
+		* old: returns value of the register before the operation
+   Return: 0, or negative error code
+   Note: the update is one atomic instruction, so it is also atomic relative to atomic
+		 instructions of processes on a mapping of data registers; the stripe is locked
+		 for writing to order it with read/write, dirty tracking and snapshots
+*/
+int char_hw_atomic(char_dev_t *hw, loff_t reg, unsigned int size, unsigned int op, u64 operand, u64 expected, u64 *old)
+{
+	unsigned char *regs;
+	ssize_t ret;
+
+	if((size != 1 && size != 2 && size != 4 && size != 8) || op >= CHAR_HW_NR_ATOMIC_OPS)
+		return -EINVAL;
+	if(reg < 0 || (reg & (size - 1)) || reg + size > hw->data_size)
+	{
+		char_hw_count_error(hw);
+		return -EINVAL;
+	}
+
+	// Permission is checked once the register is locked (permission changes wait for it)
+	char_hw_lock_range(hw, reg, size, true);
+
+	// the old value is returned, the register must be readable as well
+	if((READ_ONCE(hw->control_regs[CONTROL_ACCESS_REG]) & CTRL_READ_DATA_BIT) == DISABLE)
+	{
+		char_hw_count_error(hw);
+		ret = -EPERM;
+	}
+	else
+		ret = __char_hw_write_begin(hw, reg, size, &regs);
+
+	if(ret < 0)
+	{
+		char_hw_unlock_range(hw, reg, size, true);
+		return ret;
+	}
+
+	if(size == 8)
+		*old = char_hw_atomic64(regs, op, operand, expected);
+	else
+		*old = char_hw_atomic32(regs, size, op, operand, expected);
+
+	char_hw_write_end(hw, reg, size, size);
+	return 0;
+}
+
+/* Function: Read status data from status register
+   Note: lockless, a reader racing with an update of register bits retries,
+		 so monitoring never delays reads/writes of data registers
+*/
+void char_hw_get_status(char_dev_t *hw, sts_regs_t *status)
+{
+	char_stats_t stats;
+	unsigned int seq;
+
+	// Copy content of 5 status registers to sts_regs_t structure
+	do
+	{
+		seq = read_seqbegin(&hw->reg_seq);
+		memcpy(status, hw->status_regs, NUM_STS_REGS * REG_SIZE);
+	} while(read_seqretry(&hw->reg_seq, seq));
+
+	// Derive legacy 16-bit counter registers from the 64-bit counters
+	char_hw_get_stats(hw, &stats);
+	status->read_count_h_reg = (stats.read_ops >> 8) & 0xFF;
+	status->read_count_l_reg = stats.read_ops & 0xFF;
+	status->write_count_h_reg = (stats.write_ops >> 8) & 0xFF;
+	status->write_count_l_reg = stats.write_ops & 0xFF;
+}
+
+/* Function: Read control register and device status register together (lockless) */
+void char_hw_get_regs(char_dev_t *hw, unsigned char *control, unsigned char *device_status)
+{
+	unsigned int seq;
+
+	do
+	{
+		seq = read_seqbegin(&hw->reg_seq);
+		*control = hw->control_regs[CONTROL_ACCESS_REG];
+		*device_status = hw->status_regs[DEVICE_STATUS_REG];
+	} while(read_seqretry(&hw->reg_seq, seq));
+}
+
+/* Functions: Set up control status for control registers */
+    /* ENABLE or DISABLE READ (device locked) */
+void __char_hw_enable_read(char_dev_t *hw, unsigned char isEnable)
+{
+	unsigned char old_ctrl;
+
+	write_seqlock(&hw->reg_seq);
+	old_ctrl = hw->control_regs[CONTROL_ACCESS_REG];
+
+	if(isEnable == ENABLE)
+	{
+		// control allow read from data registers (adjust on bit 0 of CONTROL_ACCESS_REG register)
+		hw->control_regs[CONTROL_ACCESS_REG] |= CTRL_READ_DATA_BIT;
+		// update status "enable read" (adjust on bit 0 of DEVICE_STATUS_REG register)
+		hw->status_regs[DEVICE_STATUS_REG] |= STS_READ_ACCESS_BIT;
+	}
+	else
+	{
+		// control not allow read from data registers (adjust on bit 0 of CONTROL_ACCESS_REG register)
+		hw->control_regs[CONTROL_ACCESS_REG] &= ~CTRL_READ_DATA_BIT;
+		// update status "disable read" (adjust on bit 0 of DEVICE_STATUS_REG register)
+		hw->status_regs[DEVICE_STATUS_REG] &= ~STS_READ_ACCESS_BIT;
+	}
+
+	write_sequnlock(&hw->reg_seq);
+
+	if(hw->control_regs[CONTROL_ACCESS_REG] != old_ctrl)
+		char_hw_notify(hw, CHAR_HW_EV_CONTROL);
+}
+
+    /* ENABLE or DISABLE READ */
+void char_hw_enable_read(char_dev_t *hw, unsigned char isEnable)
+{
+	// wait for in-flight reads/writes, they checked the old permission
+	char_hw_lock_device(hw);
+	__char_hw_enable_read(hw, isEnable);
+	char_hw_unlock_device(hw);
+}
+
+    /* ENABLE or DISABLE WRITE (device locked) */
+void __char_hw_enable_write(char_dev_t *hw, unsigned char isEnable)
+{
+	unsigned char old_ctrl;
+
+	write_seqlock(&hw->reg_seq);
+	old_ctrl = hw->control_regs[CONTROL_ACCESS_REG];
+
+	if(isEnable == ENABLE)
+	{
+		// control allow write on data register (adjust on bit 0 of CONTROL_ACCESS_REG register)
+		hw->control_regs[CONTROL_ACCESS_REG] |= CTRL_WRITE_DATA_BIT;
+		// update status "enable write" (adjust on bit 0 of DEVICE_STATUS_REG register)
+		hw->status_regs[DEVICE_STATUS_REG] |= STS_WRITE_ACCESS_BIT;
+	}
+	else
+	{
+		// control not allow write on data registers (adjust on bit 0 of CONTROL_ACCESS_REG register)
+		hw->control_regs[CONTROL_ACCESS_REG] &= ~CTRL_WRITE_DATA_BIT;
+		// update status "disable write" (adjust on bit 0 of DEVICE_STATUS_REG register)
+		hw->status_regs[DEVICE_STATUS_REG] &= ~STS_WRITE_ACCESS_BIT;
+	}
+
+	write_sequnlock(&hw->reg_seq);
+
+	if(hw->control_regs[CONTROL_ACCESS_REG] != old_ctrl)
+		char_hw_notify(hw, CHAR_HW_EV_CONTROL);
+}
+
+    /* ENABLE or DISABLE WRITE */
+void char_hw_enable_write(char_dev_t *hw, unsigned char isEnable)
+{
+	// wait for in-flight reads/writes, they checked the old permission
+	char_hw_lock_device(hw);
+	__char_hw_enable_write(hw, isEnable);
+	char_hw_unlock_device(hw);
+}
+
+    /* ENABLE or DISABLE FIFO MODE */
+void char_hw_enable_fifo(char_dev_t *hw, unsigned char isEnable)
+{
+	unsigned char old_ctrl;
+
+	// wait for in-flight reads/writes of both modes
+	char_hw_lock_device(hw);
+	write_seqlock(&hw->reg_seq);
+	old_ctrl = hw->control_regs[CONTROL_ACCESS_REG];
+
+	if(isEnable == ENABLE)
+	{
+		// control data registers work as a FIFO (adjust on bit 2 of CONTROL_ACCESS_REG register)
+		hw->control_regs[CONTROL_ACCESS_REG] |= CTRL_FIFO_MODE_BIT;
+		// update status "FIFO mode" (adjust on bit 3 of DEVICE_STATUS_REG register)
+		hw->status_regs[DEVICE_STATUS_REG] |= STS_FIFO_MODE_BIT;
+	}
+	else
+	{
+		// control data registers are addressed by offset (adjust on bit 2 of CONTROL_ACCESS_REG register)
+		hw->control_regs[CONTROL_ACCESS_REG] &= ~CTRL_FIFO_MODE_BIT;
+		// update status "offset mode" (adjust on bit 3 of DEVICE_STATUS_REG register)
+		hw->status_regs[DEVICE_STATUS_REG] &= ~STS_FIFO_MODE_BIT;
+	}
+
+	write_sequnlock(&hw->reg_seq);
+
+	// Switching mode starts with an empty FIFO
+	hw->fifo_head = 0;
+	hw->fifo_tail = 0;
+	if(hw->control_regs[CONTROL_ACCESS_REG] != old_ctrl)
+		char_hw_notify(hw, CHAR_HW_EV_CONTROL);
+	char_hw_unlock_device(hw);
+}
+
+/* Function: Start consuming data from the FIFO
+   Parameters:
+		* hw: pointer to char device
+		* num_regs: number of register to read
+		* regs: returns address of the first register to read
+   Return: number of contiguous registers which can be read (0 if FIFO is empty),
+		   -ENOTCONN if data registers are no longer in FIFO mode, or negative error code
+   Note: on success the FIFO stays locked until char_hw_fifo_read_end()
+*/
+ssize_t char_hw_fifo_read_begin(char_dev_t *hw, size_t num_regs, unsigned char **regs)
+{
+	size_t pos, read_bytes;
+
+	mutex_lock(&hw->fifo_lock);
+
+	// The mode may have been switched since the caller checked it (not an error of the device)
+	if(!(hw->control_regs[CONTROL_ACCESS_REG] & CTRL_FIFO_MODE_BIT))
+	{
+		mutex_unlock(&hw->fifo_lock);
+		return -ENOTCONN;
+	}
+
+	// Check for reading data permission
+	if((hw->control_regs[CONTROL_ACCESS_REG] & CTRL_READ_DATA_BIT) == DISABLE)
+	{
+		mutex_unlock(&hw->fifo_lock);
+		char_hw_count_error(hw);
+		return -EPERM;
+	}
+
+	pos = hw->fifo_tail % hw->data_size;
+
+	// Do not read past stored data or across the end of data registers
+	read_bytes = min_t(size_t, num_regs, min_t(size_t, hw->fifo_head - hw->fifo_tail, hw->data_size - pos));
+	if(read_bytes == 0)
+	{
+		mutex_unlock(&hw->fifo_lock);
+		return 0;
+	}
+
+	*regs = hw->data_regs + pos;
+	return read_bytes;
+}
+
+/* Function: Finish consuming data from the FIFO
+   Parameters:
+		* hw: pointer to char device
+		* result: number of registers actually read, or negative error code
+*/
+void char_hw_fifo_read_end(char_dev_t *hw, ssize_t result)
+{
+	if(result > 0)
+		WRITE_ONCE(hw->fifo_tail, hw->fifo_tail + result);
+	mutex_unlock(&hw->fifo_lock);
+	char_hw_account_read(hw, result);
+}
+
+/* Function: Start appending data to the FIFO
+   Parameters:
+		* hw: pointer to char device
+		* num_regs: number of register to write
+		* regs: returns address of the first register to write
+   Return: number of contiguous registers which can be written (0 if FIFO is full),
+		   -ENOTCONN if data registers are no longer in FIFO mode, or negative error code
+   Note: on success the FIFO stays locked until char_hw_fifo_write_end()
+*/
+ssize_t char_hw_fifo_write_begin(char_dev_t *hw, size_t num_regs, unsigned char **regs)
+{
+	size_t pos, write_bytes;
+
+	mutex_lock(&hw->fifo_lock);
+
+	// The mode may have been switched since the caller checked it (not an error of the device)
+	if(!(hw->control_regs[CONTROL_ACCESS_REG] & CTRL_FIFO_MODE_BIT))
+	{
+		mutex_unlock(&hw->fifo_lock);
+		return -ENOTCONN;
+	}
+
+	// Check for writing data permission
+	if((hw->control_regs[CONTROL_ACCESS_REG] & CTRL_WRITE_DATA_BIT) == DISABLE)
+	{
+		mutex_unlock(&hw->fifo_lock);
+		char_hw_count_error(hw);
+		return -EPERM;
+	}
+
+	pos = hw->fifo_head % hw->data_size;
+
+	// Do not write over unread data or across the end of data registers
+	write_bytes = min_t(size_t, num_regs, min_t(size_t, hw->data_size - (hw->fifo_head - hw->fifo_tail), hw->data_size - pos));
+	if(write_bytes == 0)
+	{
+		mutex_unlock(&hw->fifo_lock);
+		return 0;
+	}
+
+	char_hw_mark_dirty(hw, pos, write_bytes);
+	if(READ_ONCE(hw->snap))
+	{
+		// FIFO appends do not lock stripes, lock them for copying into the snapshot
+		char_hw_lock_range(hw, pos, write_bytes, true);
+		__char_hw_snap_save(hw, pos, write_bytes);
+		char_hw_unlock_range(hw, pos, write_bytes, true);
+	}
+	*regs = hw->data_regs + pos;
+	return write_bytes;
+}
+
+/* Function: Finish appending data to the FIFO
+   Parameters:
+		* hw: pointer to char device
+		* result: number of registers actually written, or negative error code
+*/
+void char_hw_fifo_write_end(char_dev_t *hw, ssize_t result)
+{
+	if(result > 0)
+	{
+		WRITE_ONCE(hw->fifo_head, hw->fifo_head + result);
+		// all data registers hold unread data
+		if(hw->fifo_head - hw->fifo_tail == hw->data_size)
+		{
+			unsigned char old_status;
+
+			write_seqlock(&hw->reg_seq);
+			old_status = hw->status_regs[DEVICE_STATUS_REG];
+			hw->status_regs[DEVICE_STATUS_REG] |= STS_DATAREGS_OVERFLOW_BIT;
+			write_sequnlock(&hw->reg_seq);
+			if(!(old_status & STS_DATAREGS_OVERFLOW_BIT))
+				char_hw_notify(hw, CHAR_HW_EV_OVERFLOW);
+		}
+	}
+	mutex_unlock(&hw->fifo_lock);
+	char_hw_account_write(hw, result);
+}
+
+/* Functions: Track shared writable mappings of data registers (writes through them are not seen) */
+void char_hw_get_wr_mapping(char_dev_t *hw)
+{
+	atomic_inc(&hw->wr_mappings);
+}
+
+/* Function: Count a new shared writable mapping, not allowed while a snapshot exists */
+int char_hw_new_wr_mapping(char_dev_t *hw)
+{
+	char_hw_get_wr_mapping(hw);
+	smp_mb__after_atomic();
+	if(READ_ONCE(hw->snap))
+	{
+		atomic_dec(&hw->wr_mappings);
+		return -EBUSY;
+	}
+	return 0;
+}
+
+void char_hw_put_wr_mapping(char_dev_t *hw)
+{
+	// data written through the mapping is dirty for queries since any earlier epoch
+	WRITE_ONCE(hw->wr_mapping_epoch, atomic64_read(&hw->dirty_epoch));
+	smp_mb__before_atomic();
+	atomic_dec(&hw->wr_mappings);
+}
+
+/* Function: Start looking up dirty data registers
+   Parameters:
+		* hw: pointer to char device
+		* read_data: the caller reads data of dirty registers
+		* epoch: returns the epoch of a new query (NULL: resume a query)
+   Return: 0, or negative error code
+   Note: writers of both modes wait until char_hw_dirty_end(), so registers found dirty
+		 keep their data, and writes after the new epoch started are marked with it
+*/
+int char_hw_dirty_begin(char_dev_t *hw, bool read_data, u64 *epoch)
+{
+	mutex_lock(&hw->fifo_lock);
+	char_hw_lock_stripes(hw, 0, DATA_REGS_NUM_STRIPES - 1, false);
+
+	// Check for reading data permission
+	if(read_data && (hw->control_regs[CONTROL_ACCESS_REG] & CTRL_READ_DATA_BIT) == DISABLE)
+	{
+		char_hw_unlock_stripes(hw, 0, DATA_REGS_NUM_STRIPES - 1, false);
+		mutex_unlock(&hw->fifo_lock);
+		char_hw_count_error(hw);
+		return -EPERM;
+	}
+
+	if(epoch)
+		*epoch = atomic64_inc_return(&hw->dirty_epoch);
+	return 0;
+}
+
+/* Function: Find the next range of data registers written since an epoch
+   Parameters:
+		* hw: pointer to char device (between char_hw_dirty_begin/end)
+		* since: epoch of the previous query (0: all data registers)
+		* start_reg: first data register to look at
+		* num_regs: returns number of registers of the range
+		* regs: returns address of the first register of the range
+   Return: start register of the range, or size of data registers if there is none
+*/
+loff_t char_hw_dirty_next(char_dev_t *hw, u64 since, loff_t start_reg, size_t *num_regs, unsigned char **regs)
+{
+	unsigned long first, last;
+	bool all;
+
+	// writes through mappings are not tracked
+	all = atomic_read(&hw->wr_mappings) > 0;
+	smp_rmb();
+	if(READ_ONCE(hw->wr_mapping_epoch) >= since)
+		all = true;
+
+	// Skip clean chunks, then merge following dirty chunks into one range
+	for(first = start_reg >> hw->dirty_shift; first < hw->nr_dirty_chunks; first++)
+	{
+		if(all || READ_ONCE(hw->dirty_gens[first]) >= since)
+			break;
+	}
+	if(first >= hw->nr_dirty_chunks)
+		return hw->data_size;
+
+	for(last = first + 1; last < hw->nr_dirty_chunks; last++)
+	{
+		if(!all && READ_ONCE(hw->dirty_gens[last]) < since)
+			break;
+	}
+
+	start_reg = max_t(loff_t, start_reg, (loff_t)first << hw->dirty_shift);
+	*num_regs = min_t(size_t, (size_t)last << hw->dirty_shift, hw->data_size) - start_reg;
+	*regs = hw->data_regs + start_reg;
+	return start_reg;
+}
+
+/* Function: Finish looking up dirty data registers
+   Parameters:
+		* hw: pointer to char device
+		* read_data: the caller read data of dirty registers
+		* result: number of registers read, or negative error code
+*/
+void char_hw_dirty_end(char_dev_t *hw, bool read_data, ssize_t result)
+{
+	char_hw_unlock_stripes(hw, 0, DATA_REGS_NUM_STRIPES - 1, false);
+	mutex_unlock(&hw->fifo_lock);
+	if(read_data)
+		char_hw_account_read(hw, result);
+}
+
+/* Function: Copy all stripes not copied yet into a snapshot (writers only wait for one stripe) */
+static void char_hw_snap_copy(char_snap_t *snap)
+{
+	char_dev_t *hw = snap->hw;
+	size_t stripe_size = 1UL << hw->stripe_shift;
+	unsigned long i;
+	loff_t off;
+
+	for(i = 0; i < snap->nr_stripes; i++)
+	{
+		off = (loff_t)i << hw->stripe_shift;
+		char_hw_lock_range(hw, off, stripe_size, false);
+		if(!test_bit(i, snap->saved))
+		{
+			memcpy(snap->data_regs + off, hw->data_regs + off, min_t(size_t, stripe_size, hw->data_size - off));
+			set_bit(i, snap->saved);
+		}
+		char_hw_unlock_range(hw, off, stripe_size, false);
+		cond_resched();
+	}
+	smp_store_release(&snap->complete, true);
+}
+
+/* Function: Take a snapshot of data registers
+   Parameters:
+		* hw: pointer to char device
+		* copy: copy all data registers now instead of on write
+   Return: pointer to snapshot, or ERR_PTR() of negative error code
+		   (-EBUSY: a snapshot or a shared writable mapping exists)
+*/
+char_snap_t *char_hw_snap_create(char_dev_t *hw, bool copy)
+{
+	char_snap_t *snap;
+	int ret = 0;
+
+	snap = kzalloc(sizeof(*snap), GFP_KERNEL);
+	if(!snap)
+		return ERR_PTR(-ENOMEM);
+
+	snap->hw = hw;
+	snap->nr_stripes = DIV_ROUND_UP(hw->data_size, 1UL << hw->stripe_shift);
+	snap->saved = bitmap_zalloc(snap->nr_stripes, GFP_KERNEL);
+	if(!snap->saved)
+	{
+		ret = -ENOMEM;
+		goto failed_alloc_bitmap;
+	}
+
+	// Copies of stripes go to pages which can be mapped to user space
+	snap->data_regs = vmalloc_user(hw->data_size);
+	if(!snap->data_regs)
+	{
+		ret = -ENOMEM;
+		goto failed_alloc_data;
+	}
+
+	// The snapshot starts between two writes
+	char_hw_lock_device(hw);
+	if((hw->control_regs[CONTROL_ACCESS_REG] & CTRL_READ_DATA_BIT) == DISABLE)
+		ret = -EPERM;
+	else if(hw->snap)
+		ret = -EBUSY;
+	else
+	{
+		// Writes through shared writable mappings cannot be caught, not even while copying:
+			// no snapshot while one exists (pairs with char_hw_new_wr_mapping)
+		WRITE_ONCE(hw->snap, snap);
+		smp_mb();
+		if(atomic_read(&hw->wr_mappings) > 0)
+		{
+			WRITE_ONCE(hw->snap, NULL);
+			ret = -EBUSY;
+		}
+	}
+	char_hw_unlock_device(hw);
+	if(ret < 0)
+		goto failed_start;
+
+	if(copy)
+		char_hw_snap_copy(snap);
+
+	return snap;
+
+failed_start:
+	vfree(snap->data_regs);
+
+failed_alloc_data:
+	bitmap_free(snap->saved);
+
+failed_alloc_bitmap:
+	kfree(snap);
+	return ERR_PTR(ret);
+}
+
+/* Function: Release a snapshot of data registers */
+void char_hw_snap_destroy(char_snap_t *snap)
+{
+	char_dev_t *hw = snap->hw;
+
+	// wait for writers copying into the snapshot
+	char_hw_lock_device(hw);
+	WRITE_ONCE(hw->snap, NULL);
+	char_hw_unlock_device(hw);
+
+	vfree(snap->data_regs);
+	bitmap_free(snap->saved);
+	kfree(snap);
+}
+
+/* Function: Start reading data from a snapshot
+   Parameters:
+		* snap: pointer to snapshot
+		* start_reg: start reading data register
+		* num_regs: number of register to read
+		* regs: returns address of the first register to read
+   Return: number of registers which can be read (at most until the end of a stripe)
+   Note: the stripe stays locked for reading until char_hw_snap_read_end(),
+		 so it cannot be changed before the caller copied its data out
+*/
+ssize_t char_hw_snap_read_begin(char_snap_t *snap, loff_t start_reg, size_t num_regs, unsigned char **regs)
+{
+	char_dev_t *hw = snap->hw;
+	ssize_t read_bytes = char_hw_clamp_range(hw, start_reg, num_regs);
+	loff_t stripe_end;
+
+	if(read_bytes <= 0)
+		return read_bytes;
+
+	stripe_end = ((start_reg >> hw->stripe_shift) + 1) << hw->stripe_shift;
+	read_bytes = min_t(size_t, read_bytes, stripe_end - start_reg);
+
+	char_hw_lock_range(hw, start_reg, read_bytes, false);
+	if(test_bit(start_reg >> hw->stripe_shift, snap->saved))
+		*regs = snap->data_regs + start_reg;
+	else
+		*regs = hw->data_regs + start_reg;
+	return read_bytes;
+}
+
+/* Function: Finish reading data from a snapshot
+   Parameters:
+		* snap: pointer to snapshot
+		* start_reg: start reading data register
+		* num_regs: number of register returned by char_hw_snap_read_begin()
+		* result: number of registers actually read, or negative error code
+*/
+void char_hw_snap_read_end(char_snap_t *snap, loff_t start_reg, size_t num_regs, ssize_t result)
+{
+	char_hw_unlock_range(snap->hw, start_reg, num_regs, false);
+	char_hw_account_read(snap->hw, result);
+}
+
+/******************************* DEVICE SPECIFIC - END *****************************/
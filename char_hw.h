@@ -0,0 +1,231 @@
+/*
+	Register model of the virtual character device: data structures and functions
+	shared by the kernel module (char_driver_main.c) and user-space builds (user_app)
+*/
+#ifndef _CHAR_HW_H
+#define _CHAR_HW_H
+
+#ifdef __KERNEL__
+#include <linux/types.h>   /* Include: u64, loff_t, ... */
+#include <linux/mutex.h>   /* Include functions for FIFO locking */
+#include <linux/rwsem.h>   /* Include functions for data registers locking */
+#include <linux/seqlock.h> /* Include functions for register bits publishing */
+#include <linux/percpu.h>  /* Include functions for per-CPU statistics counters*/
+#include <linux/u64_stats_sync.h> /* Include functions for consistent 64-bit counters */
+#include <linux/atomic.h>  /* Include functions for dirty tracking epochs */
+#include <linux/spinlock.h> /* Include functions for timing model locking */
+#else
+#include "char_hw_compat.h" /* Kernel API on top of libc/pthreads (user_app) */
+#endif
+
+#include "char_driver.h"   /* Include registers description for char_driver*/
+
+typedef struct 
+{
+	unsigned char read_count_h_reg;
+	unsigned char read_count_l_reg;
+	unsigned char write_count_h_reg;
+	unsigned char write_count_l_reg;
+	unsigned char device_status_reg;
+} sts_regs_t;
+
+// 64-bit statistics counters (kept per CPU, summed when read)
+typedef struct
+{
+	u64 read_ops;     // number of successful reads
+	u64 write_ops;    // number of successful writes
+	u64 read_bytes;   // number of bytes read
+	u64 write_bytes;  // number of bytes written
+	u64 errors;       // number of rejected reads/writes
+	u64 overflows;    // number of writes truncated at the end of data registers
+} char_stats_t;
+
+// Statistics counters of one CPU (64-bit counters cannot be read in one access on 32-bit CPUs)
+typedef struct
+{
+	char_stats_t cnt;
+	struct u64_stats_sync syncp;
+} char_pcpu_stats_t;
+
+/* Events of the register model, reported to the owner of the device (char_hw_set_notify)
+	* the notifier runs in the context of the operation, possibly with device locks held:
+	  it must not sleep nor call back into the register model except char_hw_get_stats()
+	* only events enabled with char_hw_set_notify_events() are checked for
+*/
+#define CHAR_HW_EV_CONTROL (1 << 0)  // read/write permission or FIFO mode changed
+#define CHAR_HW_EV_OVERFLOW (1 << 1) // overflow bit of DEVICE_STATUS_REG got set
+#define CHAR_HW_EV_CLEAR (1 << 2)    // data registers were cleared
+#define CHAR_HW_EV_COUNT (1 << 3)    // a CPU finished another CHAR_HW_COUNT_PERIOD reads/writes
+#define CHAR_HW_COUNT_PERIOD 64
+
+/* Atomic read-modify-write operations on data registers (char_hw_atomic) */
+enum char_hw_atomic_op
+{
+	CHAR_HW_ATOMIC_ADD,  // add operand (wraps around)
+	CHAR_HW_ATOMIC_CAS,  // store operand if the register holds the expected value
+	CHAR_HW_ATOMIC_XCHG, // store operand
+	CHAR_HW_ATOMIC_AND,  // bitwise and with operand
+	CHAR_HW_ATOMIC_OR,   // bitwise or with operand
+	CHAR_HW_NR_ATOMIC_OPS
+};
+
+struct char_dev;
+typedef void (*char_hw_notify_t)(struct char_dev *hw, unsigned int events);
+
+// Lock of a stripe of data registers (one cache line each, no false sharing)
+struct char_hw_stripe
+{
+	struct rw_semaphore sem;
+} ____cacheline_aligned_in_smp;
+
+// Timing model of the device (all 0: operations complete as soon as they are issued)
+typedef struct
+{
+	u64 latency_ns;              // latency of each operation
+	u64 bandwidth;               // transfer rate in bytes per second (0: unlimited)
+	u64 jitter_ns;               // random extra latency of each operation, up to jitter_ns
+	u64 busy_ns;                 // time when the transfers issued so far are done
+	spinlock_t lock;             // protect busy_ns
+} char_hw_model_t;
+
+// Character Device data structure
+typedef struct char_dev
+{
+	unsigned char *control_regs; // control register
+	unsigned char *status_regs;  // status register
+	unsigned long fifo_head;     // FIFO mode: total number of bytes appended
+	unsigned long fifo_tail;     // FIFO mode: total number of bytes consumed
+	struct mutex fifo_lock;      // FIFO mode: serialize appending/consuming
+	unsigned char *data_regs;    // data register (page-aligned, mappable to user space)
+	size_t data_size;            // number of data registers
+	struct page **data_pages;    // pages backing data registers
+	unsigned long nr_data_pages; // number of pages backing data registers
+	bool data_vmapped;           // data registers are mapped through vmap()
+	struct char_hw_stripe *stripes; // locks of data registers
+	unsigned int stripe_shift;   // size of a stripe of data registers (log2)
+	seqlock_t reg_seq;           // serialize updates of control/status register bits, readers retry
+	char_pcpu_stats_t __percpu *stats; // statistics counters
+
+	u64 *dirty_gens;             // epoch in which each chunk of data registers was last written
+	unsigned long nr_dirty_chunks; // number of chunks of data registers
+	unsigned int dirty_shift;    // size of a chunk of data registers (log2)
+	atomic64_t dirty_epoch;      // current epoch of dirty tracking
+	atomic_t wr_mappings;        // number of shared writable mappings of data registers
+	u64 wr_mapping_epoch;        // epoch in which the last shared writable mapping went away
+
+	struct char_snap *snap;      // snapshot of data registers (set/cleared with the device locked)
+
+	char_hw_notify_t notify;     // notifier of events
+	void *notify_data;           // data of notifier (owner of the device)
+	unsigned int notify_events;  // CHAR_HW_EV_* events to report
+
+	char_hw_model_t model;       // timing model
+} char_dev_t;
+
+// Snapshot of data registers
+typedef struct char_snap
+{
+	char_dev_t *hw;              // device of the snapshot
+	unsigned char *data_regs;    // copies of stripes changed since the snapshot (mappable)
+	unsigned long *saved;        // stripes which have their copy in data_regs
+	unsigned long nr_stripes;    // number of stripes of data registers
+	bool complete;               // all stripes are copied, live data is not needed anymore
+} char_snap_t;
+
+/* Functions: Life cycle of device */
+int char_hw_init(char_dev_t *hw, size_t size, unsigned int dirty_shift, int node);
+void char_hw_exit(char_dev_t *hw);
+
+/* Functions: Statistics counters and status */
+void char_hw_count_read(char_dev_t *hw, size_t bytes);
+void char_hw_count_write(char_dev_t *hw, size_t bytes);
+void char_hw_get_stats(char_dev_t *hw, char_stats_t *stats);
+void char_hw_set_notify(char_dev_t *hw, char_hw_notify_t notify, void *data);
+void char_hw_set_notify_events(char_dev_t *hw, unsigned int events);
+void char_hw_get_status(char_dev_t *hw, sts_regs_t *status);
+void char_hw_get_regs(char_dev_t *hw, unsigned char *control, unsigned char *device_status);
+
+/* Functions: Timing model */
+void char_hw_set_model(char_dev_t *hw, u64 latency_ns, u64 bandwidth, u64 jitter_ns);
+u64 char_hw_model_complete(char_dev_t *hw, u64 now_ns, size_t bytes);
+
+/* Functions: Lock/unlock the whole device, only __char_hw_* functions can be used meanwhile */
+void char_hw_lock_device(char_dev_t *hw);
+void char_hw_unlock_device(char_dev_t *hw);
+
+/* Functions: Access data registers by offset */
+ssize_t char_hw_read_begin(char_dev_t *hw, loff_t start_reg, size_t num_regs, unsigned char **regs);
+void char_hw_read_end(char_dev_t *hw, loff_t start_reg, size_t num_regs, ssize_t result);
+ssize_t char_hw_write_begin(char_dev_t *hw, loff_t start_reg, size_t num_regs, unsigned char **regs);
+void char_hw_write_end(char_dev_t *hw, loff_t start_reg, size_t num_regs, ssize_t result);
+ssize_t char_hw_read_data(char_dev_t *hw, loff_t start_reg, size_t num_regs, char* kbuf);
+ssize_t char_hw_write_data(char_dev_t *hw, loff_t start_reg, size_t num_regs, char* kbuf);
+ssize_t __char_hw_read_begin(char_dev_t *hw, loff_t start_reg, size_t num_regs, unsigned char **regs);
+void __char_hw_read_end(char_dev_t *hw, ssize_t result);
+ssize_t __char_hw_write_begin(char_dev_t *hw, loff_t start_reg, size_t num_regs, unsigned char **regs);
+void __char_hw_write_end(char_dev_t *hw, ssize_t result);
+
+/* Functions: Clear data registers, set up control register */
+int char_hw_clear_data(char_dev_t *hw);
+int __char_hw_clear_data(char_dev_t *hw);
+ssize_t char_hw_crc32c(char_dev_t *hw, loff_t start_reg, size_t num_regs, u32 *crc);
+ssize_t char_hw_fill_data(char_dev_t *hw, loff_t start_reg, size_t num_regs, const unsigned char *pattern, size_t pattern_len);
+ssize_t char_hw_compare_data(char_dev_t *hw, loff_t start_reg, size_t num_regs, const char *kbuf, size_t *mismatch);
+int char_hw_atomic(char_dev_t *hw, loff_t reg, unsigned int size, unsigned int op, u64 operand, u64 expected, u64 *old);
+void char_hw_enable_read(char_dev_t *hw, unsigned char isEnable);
+void __char_hw_enable_read(char_dev_t *hw, unsigned char isEnable);
+void char_hw_enable_write(char_dev_t *hw, unsigned char isEnable);
+void __char_hw_enable_write(char_dev_t *hw, unsigned char isEnable);
+void char_hw_enable_fifo(char_dev_t *hw, unsigned char isEnable);
+
+/* Functions: Access data registers as a FIFO */
+ssize_t char_hw_fifo_read_begin(char_dev_t *hw, size_t num_regs, unsigned char **regs);
+void char_hw_fifo_read_end(char_dev_t *hw, ssize_t result);
+ssize_t char_hw_fifo_write_begin(char_dev_t *hw, size_t num_regs, unsigned char **regs);
+void char_hw_fifo_write_end(char_dev_t *hw, ssize_t result);
+
+/* Functions: Dirty tracking and mappings of data registers */
+void char_hw_get_wr_mapping(char_dev_t *hw);
+int char_hw_new_wr_mapping(char_dev_t *hw);
+void char_hw_put_wr_mapping(char_dev_t *hw);
+int char_hw_dirty_begin(char_dev_t *hw, bool read_data, u64 *epoch);
+loff_t char_hw_dirty_next(char_dev_t *hw, u64 since, loff_t start_reg, size_t *num_regs, unsigned char **regs);
+void char_hw_dirty_end(char_dev_t *hw, bool read_data, ssize_t result);
+
+/* Functions: Snapshots of data registers */
+char_snap_t *char_hw_snap_create(char_dev_t *hw, bool copy);
+void char_hw_snap_destroy(char_snap_t *snap);
+ssize_t char_hw_snap_read_begin(char_snap_t *snap, loff_t start_reg, size_t num_regs, unsigned char **regs);
+void char_hw_snap_read_end(char_snap_t *snap, loff_t start_reg, size_t num_regs, ssize_t result);
+
+/* Function: Check whether data registers work as a FIFO */
+static inline bool char_hw_fifo_mode(char_dev_t *hw)
+{
+	return READ_ONCE(hw->control_regs[CONTROL_ACCESS_REG]) & CTRL_FIFO_MODE_BIT;
+}
+
+/* Functions: Number of bytes stored in / free in the FIFO (no locking needed) */
+static inline size_t char_hw_fifo_used(char_dev_t *hw)
+{
+	return READ_ONCE(hw->fifo_head) - READ_ONCE(hw->fifo_tail);
+}
+
+static inline size_t char_hw_fifo_free(char_dev_t *hw)
+{
+	return hw->data_size - char_hw_fifo_used(hw);
+}
+
+/* Functions: A FIFO read/write would not wait (data/space, FIFO mode left or permission disabled) */
+static inline bool char_hw_fifo_readable(char_dev_t *hw)
+{
+	unsigned char ctrl = READ_ONCE(hw->control_regs[CONTROL_ACCESS_REG]);
+	return char_hw_fifo_used(hw) > 0 || !(ctrl & CTRL_FIFO_MODE_BIT) || !(ctrl & CTRL_READ_DATA_BIT);
+}
+
+static inline bool char_hw_fifo_writable(char_dev_t *hw)
+{
+	unsigned char ctrl = READ_ONCE(hw->control_regs[CONTROL_ACCESS_REG]);
+	return char_hw_fifo_free(hw) > 0 || !(ctrl & CTRL_FIFO_MODE_BIT) || !(ctrl & CTRL_WRITE_DATA_BIT);
+}
+
+#endif /* _CHAR_HW_H */
@@ -0,0 +1,671 @@
+/*
+    Benchmark of char_driver: drives a device file from N processes x M threads
+    with a configurable mix of operations and reports throughput and latency
+    percentiles as JSON on stdout (progress and errors go to stderr).
+
+    Example:
+        ./char_bench -d /dev/char_device_file0 -p 2 -t 4 -m read=70,write=25,ioctl=5 \
+                     -s 64-4096 -o rand -w 2 -D 10
+
+    Asynchronous reads/writes keep up to -q requests of a thread in flight, their latency
+    is the time from submission to completion in the timing model of the device
+    (/sys/class/class_char_device_file/char_device_file0/model/), e.g. to tune the depth:
+        for q in 1 2 4 8 16 32; do ./char_bench -m async_read=1 -q $q -s 4096; done
+*/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+
+typedef struct
+{
+    unsigned char read_count_h;
+    unsigned char read_count_l;
+    unsigned char write_count_h;
+    unsigned char write_count_l;
+    unsigned char device_status;
+} status_t;
+
+#define DEVICE_NODE "/dev/char_device_file0"
+
+/* Define ioctl commands code */
+#define MAGICAL_NUMBER 243
+#define GET_STATUS_CHARDEV _IOR(MAGICAL_NUMBER, 1, status_t *)
+
+/* Asynchronous reads/writes (see char_driver_main.c) */
+typedef struct
+{
+    uint64_t user_data;
+    uint64_t offset;
+    uint64_t addr;
+    uint64_t len;
+    uint32_t op;
+    uint32_t reserved;
+} char_async_req_t;
+
+typedef struct
+{
+    uint64_t user_data;
+    int64_t result;
+    uint64_t latency_ns;
+} char_async_cqe_t;
+
+typedef struct
+{
+    uint64_t reqs;
+    uint32_t nr;
+    uint32_t submitted;
+} char_async_submit_t;
+
+typedef struct
+{
+    uint64_t cqes;
+    uint32_t min_nr;
+    uint32_t max_nr;
+    int64_t timeout_ns;
+    uint32_t reaped;
+    uint32_t reserved;
+} char_async_reap_t;
+
+#define CHAR_ASYNC_SUBMIT _IOWR(MAGICAL_NUMBER, 18, char_async_submit_t)
+#define CHAR_ASYNC_REAP _IOWR(MAGICAL_NUMBER, 19, char_async_reap_t)
+#define CHAR_ASYNC_READ 0
+#define CHAR_ASYNC_WRITE 1
+#define ASYNC_REAP_BATCH 64
+
+/* Operations */
+enum
+{
+    OP_READ,      // pread()
+    OP_WRITE,     // pwrite()
+    OP_READV,     // preadv()
+    OP_WRITEV,    // pwritev()
+    OP_IOCTL,     // get status registers
+    OP_MMAP_READ, // memcpy from a shared mapping
+    OP_MMAP_WRITE,// memcpy to a shared mapping
+    OP_ASYNC_READ, // CHAR_ASYNC_SUBMIT/CHAR_ASYNC_REAP read
+    OP_ASYNC_WRITE,// CHAR_ASYNC_SUBMIT/CHAR_ASYNC_REAP write
+    NR_OPS
+};
+
+static const char *op_names[NR_OPS] =
+{
+    "read", "write", "readv", "writev", "ioctl", "mmap_read", "mmap_write", "async_read", "async_write"
+};
+
+/* Latency histogram: 16 linear sub-buckets per power of two (error below 6.25%) */
+#define HIST_SUB_BITS 4
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS ((64 - HIST_SUB_BITS + 1) * HIST_SUB)
+
+#define MAX_IOVS 64
+#define MAX_WORKERS 4096
+
+/* Statistics of one operation in one worker */
+typedef struct
+{
+    uint64_t count;
+    uint64_t bytes;
+    uint64_t errors;
+    uint64_t lat_sum;
+    uint64_t lat_min;
+    uint64_t lat_max;
+    uint64_t hist[HIST_BUCKETS];
+} op_stats_t;
+
+/* Statistics of one worker thread (shared with the parent process) */
+typedef struct
+{
+    op_stats_t ops[NR_OPS];
+    double elapsed;  // measured seconds
+    int failed;      // worker could not start
+} worker_stats_t;
+
+/* Configuration */
+static struct
+{
+    const char *device;
+    int processes;
+    int threads;
+    unsigned int mix[NR_OPS];  // weights of operations
+    unsigned int mix_total;
+    size_t size_min, size_max; // transfer size range
+    int offset_mode;           // OFFSET_*
+    off_t offset_fixed;
+    int iovs;                  // segments of vectored operations
+    int depth;                 // asynchronous requests in flight per thread
+    double warmup;             // seconds before measuring
+    double duration;           // seconds of measuring
+    unsigned int seed;
+} cfg;
+
+enum { OFFSET_SEQ, OFFSET_RAND, OFFSET_FIXED };
+static const char *offset_names[] = { "seq", "rand", "fixed" };
+
+static off_t region_size;                 // size of data registers
+static worker_stats_t *results;           // per worker results (shared memory)
+static atomic_int phase;                  // 0: warmup, 1: measuring, 2: stopped
+
+/* Function: Current time in nanoseconds */
+static inline uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Functions: Histogram bucket of a latency, and the lowest latency of a bucket */
+static inline int hist_bucket(uint64_t v)
+{
+    int msb;
+
+    if(v < HIST_SUB)
+        return v;
+    msb = 63 - __builtin_clzll(v);
+    return (msb - HIST_SUB_BITS + 1) * HIST_SUB + ((v >> (msb - HIST_SUB_BITS)) & (HIST_SUB - 1));
+}
+
+static inline uint64_t hist_value(int bucket)
+{
+    int shift = bucket / HIST_SUB - 1;
+
+    if(bucket < HIST_SUB)
+        return bucket;
+    return (uint64_t)(HIST_SUB + bucket % HIST_SUB) << shift;
+}
+
+/* Function: Simple per-thread random number generator (xorshift64*) */
+static inline uint64_t rnd(uint64_t *state)
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1DULL;
+}
+
+/* Function: Parse "read=70,write=30" into operation weights */
+static int parse_mix(char *arg)
+{
+    char *tok, *save;
+    int i;
+
+    memset(cfg.mix, 0, sizeof(cfg.mix));
+    for(tok = strtok_r(arg, ",", &save); tok; tok = strtok_r(NULL, ",", &save))
+    {
+        char *eq = strchr(tok, '=');
+
+        if(!eq)
+            return -1;
+        *eq = '\0';
+        for(i = 0; i < NR_OPS; i++)
+            if(strcmp(tok, op_names[i]) == 0)
+                break;
+        if(i == NR_OPS)
+            return -1;
+        cfg.mix[i] = strtoul(eq + 1, NULL, 0);
+    }
+
+    cfg.mix_total = 0;
+    for(i = 0; i < NR_OPS; i++)
+        cfg.mix_total += cfg.mix[i];
+    return cfg.mix_total ? 0 : -1;
+}
+
+/* Function: Parse "64" or "64-4096" into the transfer size range */
+static int parse_size(const char *arg)
+{
+    char *end;
+
+    cfg.size_min = strtoul(arg, &end, 0);
+    cfg.size_max = (*end == '-') ? strtoul(end + 1, NULL, 0) : cfg.size_min;
+    return (cfg.size_min == 0 || cfg.size_max < cfg.size_min) ? -1 : 0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "\t-d DEV     device file (default %s)\n"
+        "\t-p N       processes (default 1)\n"
+        "\t-t N       threads per process (default 1)\n"
+        "\t-m MIX     operation weights, e.g. read=70,write=30 (default read=50,write=50)\n"
+        "\t           operations: read write readv writev ioctl mmap_read mmap_write async_read async_write\n"
+        "\t-s MIN[-MAX] transfer size in bytes, random in [MIN, MAX] (default 64)\n"
+        "\t-o MODE    offsets: seq, rand or a fixed offset (default seq)\n"
+        "\t-v N       segments of readv/writev (default 4)\n"
+        "\t-q N       asynchronous requests in flight per thread (default 1)\n"
+        "\t-w SEC     warmup seconds (default 1)\n"
+        "\t-D SEC     measured seconds (default 5)\n"
+        "\t-r SEED    random seed (default 1)\n",
+        prog, DEVICE_NODE);
+    exit(2);
+}
+
+/* Function: Record one finished operation */
+static inline void record(op_stats_t *st, ssize_t ret, uint64_t lat)
+{
+    if(ret < 0)
+    {
+        st->errors++;
+        return;
+    }
+    st->count++;
+    st->bytes += ret;
+    st->lat_sum += lat;
+    if(lat < st->lat_min)
+        st->lat_min = lat;
+    if(lat > st->lat_max)
+        st->lat_max = lat;
+    st->hist[hist_bucket(lat)]++;
+}
+
+/* Function: Submit an asynchronous read/write, waiting for a completion while cfg.depth
+             requests are in flight; completions are recorded with their own latency
+   Return: 0, or -1 on error
+*/
+static int async_op(int fd, worker_stats_t *ws, int op, unsigned char *buf, size_t size, off_t pos,
+                    int *inflight, int measuring)
+{
+    char_async_req_t req = { op, pos, (uintptr_t)buf, size, op == OP_ASYNC_WRITE ? CHAR_ASYNC_WRITE : CHAR_ASYNC_READ, 0 };
+    char_async_submit_t submit = { (uintptr_t)&req, 1, 0 };
+    char_async_cqe_t cqes[ASYNC_REAP_BATCH];
+    char_async_reap_t reap = { (uintptr_t)cqes, 0, ASYNC_REAP_BATCH, 0, 0, 0 };
+    uint32_t i;
+
+    // reap what completed, wait for one completion while the queue is full
+    if(*inflight >= cfg.depth)
+    {
+        reap.min_nr = 1;
+        reap.timeout_ns = -1;
+    }
+    if(ioctl(fd, CHAR_ASYNC_REAP, &reap) < 0)
+        return -1;
+    *inflight -= reap.reaped;
+    for(i = 0; i < reap.reaped && measuring; i++)
+        record(&ws->ops[cqes[i].user_data], cqes[i].result, cqes[i].latency_ns);
+
+    if(ioctl(fd, CHAR_ASYNC_SUBMIT, &submit) < 0)
+        return -1;
+    (*inflight)++;
+    return 0;
+}
+
+/* Function: Worker thread, runs the operation mix until the benchmark stops */
+static void *worker(void *arg)
+{
+    worker_stats_t *ws = arg;
+    uint64_t state = ((uint64_t)cfg.seed << 32) ^ ((ws - results) + 1) * 0x9E3779B97F4A7C15ULL;
+    unsigned char *buf, *map = NULL;
+    struct iovec iov[MAX_IOVS];
+    off_t pos = 0;
+    uint64_t start = 0;
+    int fd, i, measuring = 0, inflight = 0;
+
+    for(i = 0; i < NR_OPS; i++)
+        ws->ops[i].lat_min = UINT64_MAX;
+
+    fd = open(cfg.device, O_RDWR);
+    buf = malloc(cfg.size_max);
+    if(fd < 0 || !buf)
+    {
+        perror(cfg.device);
+        ws->failed = 1;
+        return NULL;
+    }
+    memset(buf, 0xA5, cfg.size_max);
+
+    if((cfg.mix[OP_MMAP_READ] || cfg.mix[OP_MMAP_WRITE]) && region_size > 0)
+    {
+        map = mmap(NULL, region_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if(map == MAP_FAILED)
+        {
+            perror("mmap");
+            ws->failed = 1;
+            close(fd);
+            free(buf);
+            return NULL;
+        }
+    }
+
+    while(atomic_load_explicit(&phase, memory_order_relaxed) < 2)
+    {
+        unsigned int pick = rnd(&state) % cfg.mix_total;
+        size_t size = cfg.size_min;
+        uint64_t t0, t1;
+        ssize_t ret;
+        int op;
+
+        // switch to measuring once warmup is over
+        if(!measuring && atomic_load_explicit(&phase, memory_order_relaxed) == 1)
+        {
+            measuring = 1;
+            start = now_ns();
+        }
+
+        for(op = 0; pick >= cfg.mix[op]; op++)
+            pick -= cfg.mix[op];
+
+        if(cfg.size_max > cfg.size_min)
+            size += rnd(&state) % (cfg.size_max - cfg.size_min + 1);
+
+        // choose the offset of the transfer inside data registers
+        if(region_size > 0)
+        {
+            if(size > (size_t)region_size)
+                size = region_size;
+            if(cfg.offset_mode == OFFSET_RAND)
+                pos = rnd(&state) % (region_size - size + 1);
+            else if(cfg.offset_mode == OFFSET_FIXED)
+                pos = cfg.offset_fixed;
+            else if(pos + (off_t)size > region_size)
+                pos = 0;
+        }
+
+        if(op == OP_READV || op == OP_WRITEV)
+        {
+            // split the transfer into equal segments
+            size_t seg = size / cfg.iovs ? size / cfg.iovs : 1;
+            for(i = 0; i < cfg.iovs; i++)
+            {
+                iov[i].iov_base = buf + i * seg;
+                iov[i].iov_len = (i == cfg.iovs - 1) ? size - i * seg : seg;
+                if(i * seg >= size)
+                    iov[i].iov_len = 0;
+            }
+        }
+
+        t0 = now_ns();
+        switch(op)
+        {
+            case OP_READ:
+                ret = pread(fd, buf, size, pos);
+                break;
+            case OP_WRITE:
+                ret = pwrite(fd, buf, size, pos);
+                break;
+            case OP_READV:
+                ret = preadv(fd, iov, cfg.iovs, pos);
+                break;
+            case OP_WRITEV:
+                ret = pwritev(fd, iov, cfg.iovs, pos);
+                break;
+            case OP_IOCTL:
+            {
+                status_t status;
+                ret = ioctl(fd, GET_STATUS_CHARDEV, &status);
+            }
+                break;
+            case OP_MMAP_READ:
+                ret = map ? (memcpy(buf, map + pos, size), (ssize_t)size) : -1;
+                break;
+            case OP_ASYNC_READ:
+            case OP_ASYNC_WRITE:
+                // recorded when reaped, unless the submission fails
+                ret = async_op(fd, ws, op, buf, size, pos, &inflight, measuring);
+                if(ret == 0)
+                {
+                    if(cfg.offset_mode == OFFSET_SEQ)
+                        pos += size;
+                    continue;
+                }
+                break;
+            default:
+                ret = map ? (memcpy(map + pos, buf, size), (ssize_t)size) : -1;
+                break;
+        }
+        t1 = now_ns();
+
+        if(cfg.offset_mode == OFFSET_SEQ && ret > 0)
+            pos += ret;
+        if(measuring)
+            record(&ws->ops[op], ret, t1 - t0);
+    }
+
+    if(measuring)
+        ws->elapsed = (now_ns() - start) / 1e9;
+
+    if(map)
+        munmap(map, region_size);
+    close(fd);
+    free(buf);
+    return NULL;
+}
+
+/* Function: Run the threads of one process, the process leads phases of its own threads */
+static void run_process(worker_stats_t *ws)
+{
+    pthread_t tids[cfg.threads];
+    struct timespec ts;
+    int i;
+
+    for(i = 0; i < cfg.threads; i++)
+    {
+        if(pthread_create(&tids[i], NULL, worker, &ws[i]))
+        {
+            ws[i].failed = 1;
+            tids[i] = 0;
+        }
+    }
+
+    ts.tv_sec = (time_t)cfg.warmup;
+    ts.tv_nsec = (long)((cfg.warmup - ts.tv_sec) * 1e9);
+    nanosleep(&ts, NULL);
+    atomic_store(&phase, 1);
+
+    ts.tv_sec = (time_t)cfg.duration;
+    ts.tv_nsec = (long)((cfg.duration - ts.tv_sec) * 1e9);
+    nanosleep(&ts, NULL);
+    atomic_store(&phase, 2);
+
+    for(i = 0; i < cfg.threads; i++)
+        if(tids[i])
+            pthread_join(tids[i], NULL);
+}
+
+/* Function: Print latency and throughput of merged statistics as a JSON object */
+static void print_stats(const char *name, const op_stats_t *st, double elapsed, int last)
+{
+    static const double pcts[] = { 50, 90, 99, 99.9, 99.99 };
+    static const char *pct_names[] = { "p50", "p90", "p99", "p999", "p9999" };
+    uint64_t sum = 0;
+    int b = 0, i;
+
+    printf("    \"%s\": {\"count\": %llu, \"bytes\": %llu, \"errors\": %llu, "
+           "\"ops_per_sec\": %.1f, \"mib_per_sec\": %.3f, \"lat_ns\": {",
+           name, (unsigned long long)st->count, (unsigned long long)st->bytes,
+           (unsigned long long)st->errors,
+           elapsed > 0 ? st->count / elapsed : 0.0,
+           elapsed > 0 ? st->bytes / elapsed / (1024 * 1024) : 0.0);
+    printf("\"min\": %llu, \"mean\": %.1f, ",
+           (unsigned long long)(st->count ? st->lat_min : 0),
+           st->count ? (double)st->lat_sum / st->count : 0.0);
+
+    // percentiles are lower bounds of histogram buckets
+    for(i = 0; i < 5; i++)
+    {
+        uint64_t rank = (uint64_t)(st->count * pcts[i] / 100.0 + 0.5);
+
+        if(rank == 0)
+            rank = 1;
+        while(b < HIST_BUCKETS - 1 && sum + st->hist[b] < rank)
+            sum += st->hist[b++];
+        printf("\"%s\": %llu, ", pct_names[i], (unsigned long long)(st->count ? hist_value(b) : 0));
+    }
+    printf("\"max\": %llu}}%s\n", (unsigned long long)st->lat_max, last ? "" : ",");
+}
+
+/* Function: Merge statistics of one operation into another */
+static void merge(op_stats_t *to, const op_stats_t *from)
+{
+    int b;
+
+    to->count += from->count;
+    to->bytes += from->bytes;
+    to->errors += from->errors;
+    to->lat_sum += from->lat_sum;
+    if(from->count && from->lat_min < to->lat_min)
+        to->lat_min = from->lat_min;
+    if(from->lat_max > to->lat_max)
+        to->lat_max = from->lat_max;
+    for(b = 0; b < HIST_BUCKETS; b++)
+        to->hist[b] += from->hist[b];
+}
+
+int main(int argc, char **argv)
+{
+    static op_stats_t merged[NR_OPS], total;
+    int nworkers, opt, i, j, failed = 0;
+    double elapsed = 0;
+    char mix_default[] = "read=50,write=50";
+    int fd;
+
+    cfg.device = DEVICE_NODE;
+    cfg.processes = 1;
+    cfg.threads = 1;
+    cfg.size_min = cfg.size_max = 64;
+    cfg.offset_mode = OFFSET_SEQ;
+    cfg.iovs = 4;
+    cfg.depth = 1;
+    cfg.warmup = 1;
+    cfg.duration = 5;
+    cfg.seed = 1;
+    parse_mix(mix_default);
+
+    while((opt = getopt(argc, argv, "d:p:t:m:s:o:v:q:w:D:r:h")) != -1)
+    {
+        switch(opt)
+        {
+            case 'd': cfg.device = optarg; break;
+            case 'p': cfg.processes = atoi(optarg); break;
+            case 't': cfg.threads = atoi(optarg); break;
+            case 'm': if(parse_mix(optarg)) usage(argv[0]); break;
+            case 's': if(parse_size(optarg)) usage(argv[0]); break;
+            case 'o':
+                if(strcmp(optarg, "seq") == 0)
+                    cfg.offset_mode = OFFSET_SEQ;
+                else if(strcmp(optarg, "rand") == 0)
+                    cfg.offset_mode = OFFSET_RAND;
+                else
+                {
+                    cfg.offset_mode = OFFSET_FIXED;
+                    cfg.offset_fixed = strtoll(optarg, NULL, 0);
+                }
+                break;
+            case 'v': cfg.iovs = atoi(optarg); break;
+            case 'q': cfg.depth = atoi(optarg); break;
+            case 'w': cfg.warmup = atof(optarg); break;
+            case 'D': cfg.duration = atof(optarg); break;
+            case 'r': cfg.seed = strtoul(optarg, NULL, 0); break;
+            default: usage(argv[0]);
+        }
+    }
+    if(cfg.processes < 1 || cfg.threads < 1 || cfg.iovs < 1 || cfg.iovs > MAX_IOVS || cfg.depth < 1 ||
+       cfg.duration <= 0 || cfg.warmup < 0 || (long)cfg.processes * cfg.threads > MAX_WORKERS)
+        usage(argv[0]);
+
+    // Size of data registers (the device seeks inside them, a FIFO cannot seek)
+    fd = open(cfg.device, O_RDWR);
+    if(fd < 0)
+    {
+        perror(cfg.device);
+        return 1;
+    }
+    region_size = lseek(fd, 0, SEEK_END);
+    if(region_size < 0)
+        region_size = 0;
+    close(fd);
+    if(cfg.offset_mode == OFFSET_FIXED && region_size > 0 &&
+       (cfg.offset_fixed < 0 || cfg.offset_fixed + (off_t)cfg.size_max > region_size))
+    {
+        fprintf(stderr, "fixed offset does not fit into %lld bytes of data registers\n", (long long)region_size);
+        return 2;
+    }
+
+    // Results of all workers live in memory shared with child processes
+    nworkers = cfg.processes * cfg.threads;
+    results = mmap(NULL, nworkers * sizeof(worker_stats_t), PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if(results == MAP_FAILED)
+    {
+        perror("mmap");
+        return 1;
+    }
+
+    fprintf(stderr, "running %d process(es) x %d thread(s) on %s: %.1fs warmup, %.1fs measured\n",
+            cfg.processes, cfg.threads, cfg.device, cfg.warmup, cfg.duration);
+    for(i = 0; i < cfg.processes; i++)
+    {
+        pid_t pid = fork();
+
+        if(pid < 0)
+        {
+            perror("fork");
+            return 1;
+        }
+        if(pid == 0)
+        {
+            run_process(&results[i * cfg.threads]);
+            _exit(0);
+        }
+    }
+    while(wait(NULL) > 0)
+        ;
+
+    // Merge results of all workers
+    total.lat_min = UINT64_MAX;
+    for(j = 0; j < NR_OPS; j++)
+        merged[j].lat_min = UINT64_MAX;
+    for(i = 0; i < nworkers; i++)
+    {
+        failed += results[i].failed;
+        if(results[i].elapsed > elapsed)
+            elapsed = results[i].elapsed;
+        for(j = 0; j < NR_OPS; j++)
+        {
+            merge(&merged[j], &results[i].ops[j]);
+            merge(&total, &results[i].ops[j]);
+        }
+    }
+
+    // Report
+    printf("{\n");
+    printf("  \"config\": {\"device\": \"%s\", \"processes\": %d, \"threads\": %d, "
+           "\"size_min\": %zu, \"size_max\": %zu, \"offsets\": \"%s\", \"iovs\": %d, "
+           "\"warmup_sec\": %.3f, \"duration_sec\": %.3f, \"seed\": %u, \"region_size\": %lld, \"mix\": {",
+           cfg.device, cfg.processes, cfg.threads, cfg.size_min, cfg.size_max,
+           offset_names[cfg.offset_mode], cfg.iovs, cfg.warmup, cfg.duration, cfg.seed,
+           (long long)region_size);
+    for(i = 0, j = 0; i < NR_OPS; i++)
+        if(cfg.mix[i])
+            printf("%s\"%s\": %u", j++ ? ", " : "", op_names[i], cfg.mix[i]);
+    printf("}},\n");
+    printf("  \"failed_workers\": %d,\n", failed);
+    printf("  \"elapsed_sec\": %.3f,\n", elapsed);
+    printf("  \"ops\": {\n");
+    for(i = 0, j = 0; i < NR_OPS; i++)
+        if(cfg.mix[i])
+            j++;
+    for(i = 0; i < NR_OPS; i++)
+        if(cfg.mix[i])
+            print_stats(op_names[i], &merged[i], elapsed, --j == 0);
+    printf("  },\n");
+    printf("  \"total\": {\n");
+    print_stats("all", &total, elapsed, 1);
+    printf("  }\n");
+    printf("}\n");
+
+    munmap(results, nworkers * sizeof(worker_stats_t));
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,216 @@
+/*
+    Microbenchmark of the register model (char_hw.c built in user space, see Makefile):
+    measures ns/op of char_hw_read_data/char_hw_write_data (copy through a buffer) and
+    char_hw_read_begin/end, char_hw_write_begin/end (zero-copy access of locked registers)
+    across transfer sizes and alignments, without loading the module or crossing syscalls.
+    Prints one JSON object per measurement on stdout.
+
+    Example:
+        ./char_hw_bench -S 1048576 -s 1,64,4096,65536 -a 0,1,63 -n 200000
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "char_hw.h"
+
+#define DEFAULT_DATA_SIZE (1 << 20)
+#define DEFAULT_ITERS 100000
+#define MAX_LIST 32
+
+/* Operations */
+enum
+{
+    OP_READ_DATA,   // char_hw_read_data()
+    OP_WRITE_DATA,  // char_hw_write_data()
+    OP_READ_BEGIN,  // char_hw_read_begin()/char_hw_read_end()
+    OP_WRITE_BEGIN, // char_hw_write_begin()/char_hw_write_end()
+    NR_OPS
+};
+
+static const char *op_names[NR_OPS] =
+{
+    "read_data", "write_data", "read_begin", "write_begin"
+};
+
+static volatile unsigned char sink;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/* Function: Parse a comma-separated list of numbers
+   Return: number of entries, or -1 on error
+*/
+static int parse_list(const char *arg, size_t *list)
+{
+    char *end;
+    int n = 0;
+
+    while(*arg && n < MAX_LIST)
+    {
+        list[n++] = strtoul(arg, &end, 0);
+        if(end == arg || (*end && *end != ','))
+            return -1;
+        arg = *end ? end + 1 : end;
+    }
+    return n;
+}
+
+/* Function: Run one operation at offsets walking over data registers
+   Return: nanoseconds per operation, or -1 on error
+*/
+static double run(char_dev_t *hw, int op, size_t size, size_t align, unsigned long iters, char *buf)
+{
+    size_t span = (hw->data_size - align) / size * size;
+    unsigned char *regs;
+    loff_t off = 0;
+    uint64_t start;
+    unsigned long i;
+    ssize_t ret;
+
+    start = now_ns();
+    for(i = 0; i < iters; i++)
+    {
+        loff_t pos = align + off;
+
+        switch(op)
+        {
+            case OP_READ_DATA:
+                ret = char_hw_read_data(hw, pos, size, buf);
+                break;
+            case OP_WRITE_DATA:
+                ret = char_hw_write_data(hw, pos, size, buf);
+                break;
+            case OP_READ_BEGIN:
+                ret = char_hw_read_begin(hw, pos, size, &regs);
+                if(ret > 0)
+                    sink = regs[ret - 1];
+                if(ret >= 0)
+                    char_hw_read_end(hw, pos, ret, ret);
+                break;
+            default:
+                ret = char_hw_write_begin(hw, pos, size, &regs);
+                if(ret > 0)
+                    regs[ret - 1] = (unsigned char)i;
+                if(ret >= 0)
+                    char_hw_write_end(hw, pos, ret, ret);
+                break;
+        }
+        if(ret != (ssize_t)size)
+        {
+            fprintf(stderr, "%s at %lld, %zu bytes: returned %zd\n", op_names[op], (long long)pos, size, ret);
+            return -1;
+        }
+
+        off += size;
+        if(off >= span)
+            off = 0;
+    }
+    return (double)(now_ns() - start) / iters;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -S BYTES   size of data registers (default %d)\n"
+            "  -s LIST    transfer sizes in bytes (default 1,16,64,256,4096,65536)\n"
+            "  -a LIST    offsets of transfers from a page boundary (default 0,1,63)\n"
+            "  -n N       operations per measurement (default %d)\n"
+            "  -r N       repeat each measurement N times, report the fastest (default 3)\n",
+            prog, DEFAULT_DATA_SIZE, DEFAULT_ITERS);
+}
+
+int main(int argc, char *argv[])
+{
+    size_t sizes[MAX_LIST] = { 1, 16, 64, 256, 4096, 65536 };
+    size_t aligns[MAX_LIST] = { 0, 1, 63 };
+    int nr_sizes = 6, nr_aligns = 3, repeat = 3;
+    size_t data_size = DEFAULT_DATA_SIZE;
+    unsigned long iters = DEFAULT_ITERS;
+    char_dev_t hw = { 0 };
+    char *buf;
+    int opt, op, s, a, r;
+
+    while((opt = getopt(argc, argv, "S:s:a:n:r:h")) != -1)
+    {
+        switch(opt)
+        {
+            case 'S':
+                data_size = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                nr_sizes = parse_list(optarg, sizes);
+                break;
+            case 'a':
+                nr_aligns = parse_list(optarg, aligns);
+                break;
+            case 'n':
+                iters = strtoul(optarg, NULL, 0);
+                break;
+            case 'r':
+                repeat = atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if(nr_sizes <= 0 || nr_aligns <= 0 || iters == 0 || repeat <= 0)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if(char_hw_init(&hw, data_size, PAGE_SHIFT, NUMA_NO_NODE) < 0)
+    {
+        fprintf(stderr, "Cannot initialize device of %zu bytes\n", data_size);
+        return 1;
+    }
+
+    for(s = 0; s < nr_sizes; s++)
+    {
+        buf = malloc(sizes[s]);
+        if(!buf)
+            break;
+        memset(buf, 0xa5, sizes[s]);
+
+        for(a = 0; a < nr_aligns; a++)
+        {
+            if(sizes[s] + aligns[a] > data_size)
+                continue;
+
+            for(op = 0; op < NR_OPS; op++)
+            {
+                double best = -1, ns;
+
+                for(r = 0; r < repeat; r++)
+                {
+                    ns = run(&hw, op, sizes[s], aligns[a], iters, buf);
+                    if(ns < 0)
+                        goto out;
+                    if(best < 0 || ns < best)
+                        best = ns;
+                }
+                printf("{\"op\": \"%s\", \"size\": %zu, \"align\": %zu, \"ns_per_op\": %.1f, \"gb_per_s\": %.2f}\n",
+                       op_names[op], sizes[s], aligns[a], best, sizes[s] / best);
+            }
+        }
+        free(buf);
+    }
+
+    char_hw_exit(&hw);
+    return 0;
+
+out:
+    free(buf);
+    char_hw_exit(&hw);
+    return 1;
+}
@@ -0,0 +1,231 @@
+/*
+	Kernel API used by the register model (char_hw.c), implemented on libc/pthreads,
+	so the register model builds as a user-space library (libchar_hw.a)
+	* one "CPU": per-CPU statistics counters are a single copy, counters are exact
+	  as long as one thread uses a device at a time
+	* locks are pthread locks, lockdep classes are ignored
+*/
+#ifndef _CHAR_HW_COMPAT_H
+#define _CHAR_HW_COMPAT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+/* Types */
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef int32_t s32;
+typedef uint64_t u64;
+typedef int64_t s64;
+
+#define __percpu
+#define ____cacheline_aligned_in_smp __attribute__((aligned(64)))
+#define L1_CACHE_SHIFT 6
+#define PAGE_SHIFT 12
+#define PAGE_SIZE (1UL << PAGE_SHIFT)
+#define PAGE_ALIGN(x) (((x) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1))
+#define NUMA_NO_NODE (-1)
+#define GFP_KERNEL 0
+#define BITS_PER_LONG (8 * sizeof(long))
+
+struct page;
+
+/* Helpers */
+#define READ_ONCE(x) (*(const volatile __typeof__(x) *)&(x))
+#define WRITE_ONCE(x, v) (*(volatile __typeof__(x) *)&(x) = (v))
+#define min_t(type, a, b) ((type)(a) < (type)(b) ? (type)(a) : (type)(b))
+#define max_t(type, a, b) ((type)(a) > (type)(b) ? (type)(a) : (type)(b))
+#define clamp_t(type, v, lo, hi) min_t(type, max_t(type, v, lo), hi)
+#define DIV_ROUND_UP(n, d) (((n) + (d) - 1) / (d))
+#define NSEC_PER_SEC 1000000000ULL
+#define cond_resched() do { } while(0)
+
+static inline int fls64(u64 x)
+{
+	return x ? 64 - __builtin_clzll(x) : 0;
+}
+
+static inline unsigned int order_base_2(unsigned long n)
+{
+	return n > 1 ? fls64(n - 1) : 0;
+}
+
+static inline u64 mul_u64_u64_div_u64(u64 a, u64 b, u64 c)
+{
+	return (unsigned __int128)a * b / c;
+}
+
+static inline u64 mul_u64_u32_shr(u64 a, u32 mul, unsigned int shift)
+{
+	return (unsigned __int128)a * mul >> shift;
+}
+
+/* Random numbers (not for cryptography, unlike the kernel's) */
+static inline u32 get_random_u32(void)
+{
+	return (u32)random() << 16 ^ (u32)random();
+}
+
+/* Error pointers */
+#define ERR_PTR(err) ((void *)(long)(err))
+#define PTR_ERR(ptr) ((long)(ptr))
+#define IS_ERR(ptr) ((unsigned long)(ptr) >= (unsigned long)-4095)
+
+/* Memory */
+static inline void *kzalloc(size_t size, int gfp)
+{
+	return calloc(1, size);
+}
+#define kzalloc_node(size, gfp, node) kzalloc(size, gfp)
+#define kvzalloc_node(size, gfp, node) kzalloc(size, gfp)
+#define kfree(p) free((void *)(p))
+#define kvfree(p) free((void *)(p))
+
+static inline void *vmalloc_user(size_t size)
+{
+	void *p;
+
+	if(posix_memalign(&p, PAGE_SIZE, PAGE_ALIGN(size)))
+		return NULL;
+	return memset(p, 0, PAGE_ALIGN(size));
+}
+#define vfree(p) free((void *)(p))
+
+/* CRC32C (Castagnoli, reflected, no inversion like the kernel's crc32c()) */
+static inline u32 crc32c(u32 crc, const void *address, unsigned int length)
+{
+	const unsigned char *p = address;
+	int k;
+
+	while(length--)
+	{
+		crc ^= *p++;
+		for(k = 0; k < 8; k++)
+			crc = (crc >> 1) ^ (0x82f63b78 & -(crc & 1));
+	}
+	return crc;
+}
+
+/* Barriers and atomics */
+#define smp_mb() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define smp_rmb() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define smp_wmb() __atomic_thread_fence(__ATOMIC_RELEASE)
+#define smp_mb__before_atomic() smp_mb()
+#define smp_mb__after_atomic() smp_mb()
+#define smp_load_acquire(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define smp_store_release(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+
+typedef struct { int counter; } atomic_t;
+typedef struct { s64 counter; } atomic64_t;
+
+#define atomic_read(v) __atomic_load_n(&(v)->counter, __ATOMIC_RELAXED)
+#define atomic_set(v, i) __atomic_store_n(&(v)->counter, i, __ATOMIC_RELAXED)
+#define atomic_inc(v) ((void)__atomic_fetch_add(&(v)->counter, 1, __ATOMIC_RELAXED))
+#define atomic_dec(v) ((void)__atomic_fetch_sub(&(v)->counter, 1, __ATOMIC_RELAXED))
+#define atomic64_read(v) __atomic_load_n(&(v)->counter, __ATOMIC_RELAXED)
+#define atomic64_set(v, i) __atomic_store_n(&(v)->counter, i, __ATOMIC_RELAXED)
+#define atomic64_inc_return(v) __atomic_add_fetch(&(v)->counter, 1, __ATOMIC_SEQ_CST)
+#define cmpxchg(p, old, new) __sync_val_compare_and_swap(p, old, new)
+#define cmpxchg64(p, old, new) __sync_val_compare_and_swap(p, old, new)
+
+/* Bitmaps */
+static inline unsigned long *bitmap_zalloc(unsigned int nbits, int gfp)
+{
+	return calloc(DIV_ROUND_UP(nbits, BITS_PER_LONG), sizeof(unsigned long));
+}
+#define bitmap_free(p) free(p)
+
+static inline void set_bit(unsigned long nr, unsigned long *addr)
+{
+	__atomic_fetch_or(&addr[nr / BITS_PER_LONG], 1UL << (nr % BITS_PER_LONG), __ATOMIC_RELAXED);
+}
+
+static inline bool test_bit(unsigned long nr, const unsigned long *addr)
+{
+	return (__atomic_load_n(&addr[nr / BITS_PER_LONG], __ATOMIC_RELAXED) >> (nr % BITS_PER_LONG)) & 1;
+}
+
+/* Per-CPU data: one copy */
+#define alloc_percpu(type) ((type *)calloc(1, sizeof(type)))
+#define free_percpu(p) free(p)
+#define for_each_possible_cpu(cpu) for((cpu) = 0; (cpu) < 1; (cpu)++)
+#define per_cpu_ptr(p, cpu) (p)
+#define get_cpu_ptr(p) (p)
+#define put_cpu_ptr(p) do { } while(0)
+
+/* 64-bit statistics counters: always read in one access */
+struct u64_stats_sync { };
+#define u64_stats_init(s) do { } while(0)
+#define u64_stats_update_begin(s) do { } while(0)
+#define u64_stats_update_end(s) do { } while(0)
+#define u64_stats_fetch_begin(s) 0
+#define u64_stats_fetch_retry(s, start) ((void)(start), false)
+
+/* Locks */
+struct lock_class_key { int unused; };
+
+struct rw_semaphore { pthread_rwlock_t lock; };
+#define __init_rwsem(sem, name, key) ((void)(key), pthread_rwlock_init(&(sem)->lock, NULL))
+#define down_read(sem) pthread_rwlock_rdlock(&(sem)->lock)
+#define up_read(sem) pthread_rwlock_unlock(&(sem)->lock)
+#define down_write(sem) pthread_rwlock_wrlock(&(sem)->lock)
+#define up_write(sem) pthread_rwlock_unlock(&(sem)->lock)
+
+typedef struct { pthread_mutex_t lock; } spinlock_t;
+#define spin_lock_init(l) pthread_mutex_init(&(l)->lock, NULL)
+#define spin_lock(l) pthread_mutex_lock(&(l)->lock)
+#define spin_unlock(l) pthread_mutex_unlock(&(l)->lock)
+
+struct mutex { pthread_mutex_t lock; };
+#define mutex_init(m) pthread_mutex_init(&(m)->lock, NULL)
+#define mutex_lock(m) pthread_mutex_lock(&(m)->lock)
+#define mutex_unlock(m) pthread_mutex_unlock(&(m)->lock)
+
+typedef struct
+{
+	unsigned int seq;
+	pthread_mutex_t lock;
+} seqlock_t;
+
+static inline void seqlock_init(seqlock_t *sl)
+{
+	sl->seq = 0;
+	pthread_mutex_init(&sl->lock, NULL);
+}
+
+static inline void write_seqlock(seqlock_t *sl)
+{
+	pthread_mutex_lock(&sl->lock);
+	__atomic_store_n(&sl->seq, sl->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void write_sequnlock(seqlock_t *sl)
+{
+	__atomic_store_n(&sl->seq, sl->seq + 1, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&sl->lock);
+}
+
+static inline unsigned int read_seqbegin(const seqlock_t *sl)
+{
+	unsigned int seq;
+
+	while((seq = __atomic_load_n(&sl->seq, __ATOMIC_ACQUIRE)) & 1)
+		;
+	return seq;
+}
+
+static inline bool read_seqretry(const seqlock_t *sl, unsigned int start)
+{
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	return __atomic_load_n(&sl->seq, __ATOMIC_RELAXED) != start;
+}
+
+#endif /* _CHAR_HW_COMPAT_H */
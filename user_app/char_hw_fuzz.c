@@ -0,0 +1,742 @@
+/*
+    Fuzz harness of the register model (char_hw.c built in user space, see Makefile):
+    decodes an input into a sequence of operations on a device (offset reads/writes,
+    FIFO appends/consumes, clear, permission and mode changes, snapshots, dirty lookups,
+    checksum/fill/compare) and checks every result, data byte, status bit and statistics
+    counter against a shadow model of the device. A mismatch prints the operation and aborts.
+
+    Standalone:  ./char_hw_fuzz [-n RUNS] [-l LENGTH] [-s SEED]   (random inputs)
+                 ./char_hw_fuzz FILE...                           (replay inputs)
+    libFuzzer:   make char_hw_fuzz_libfuzzer   (clang -fsanitize=fuzzer,address)
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "char_hw.h"
+
+#define FUZZ_MAX_DATA_SIZE 16384
+
+/* Operations */
+enum
+{
+    FUZZ_READ,          // char_hw_read_data()
+    FUZZ_WRITE,         // char_hw_write_data()
+    FUZZ_CLEAR,         // char_hw_clear_data()
+    FUZZ_ENABLE_READ,   // char_hw_enable_read()
+    FUZZ_ENABLE_WRITE,  // char_hw_enable_write()
+    FUZZ_ENABLE_FIFO,   // char_hw_enable_fifo()
+    FUZZ_FIFO_WRITE,    // char_hw_fifo_write_begin()/end()
+    FUZZ_FIFO_READ,     // char_hw_fifo_read_begin()/end()
+    FUZZ_SNAP,          // char_hw_snap_create()/char_hw_snap_destroy()
+    FUZZ_SNAP_READ,     // char_hw_snap_read_begin()/end()
+    FUZZ_DIRTY,         // char_hw_dirty_begin()/next()/end()
+    FUZZ_CRC,           // char_hw_crc32c()
+    FUZZ_FILL,          // char_hw_fill_data()
+    FUZZ_COMPARE,       // char_hw_compare_data()
+    FUZZ_ATOMIC,        // char_hw_atomic()
+    FUZZ_MAP,           // char_hw_new_wr_mapping()/char_hw_put_wr_mapping()
+    FUZZ_MAP_WRITE,     // store through the shared writable mapping
+    FUZZ_CHECK,         // char_hw_get_status(), char_hw_get_stats()
+    NR_FUZZ_OPS
+};
+
+/* Shadow model of a device */
+typedef struct
+{
+    unsigned char *data;      // expected data registers
+    unsigned char *snap;      // expected data registers of the snapshot
+    unsigned char *dirty;     // registers written since the last dirty lookup
+    size_t size;
+    bool read_en, write_en, fifo_mode, overflow;
+    bool mapped;              // a shared writable mapping exists
+    unsigned long head, tail; // FIFO positions
+    u64 since;                // epoch of the last dirty lookup
+    char_stats_t stats;       // expected statistics counters
+} shadow_t;
+
+/* Input decoder */
+typedef struct
+{
+    const uint8_t *data;
+    size_t len;
+    size_t pos;
+} input_t;
+
+static unsigned int take(input_t *in, int bytes)
+{
+    unsigned int v = 0;
+
+    while(bytes-- > 0)
+        v = (v << 8) | (in->pos < in->len ? in->data[in->pos++] : 0);
+    return v;
+}
+
+#define CHECK(cond, ...)                                                \
+    do                                                                  \
+    {                                                                   \
+        if(!(cond))                                                     \
+        {                                                               \
+            fprintf(stderr, "char_hw_fuzz: %s:%d: %s: ", __FILE__, __LINE__, #cond); \
+            fprintf(stderr, __VA_ARGS__);                               \
+            fputc('\n', stderr);                                        \
+            abort();                                                    \
+        }                                                               \
+    } while(0)
+
+static void mark_written(shadow_t *sh, size_t off, size_t len)
+{
+    memset(sh->dirty + off, 1, len);
+}
+
+static void do_read(char_dev_t *hw, shadow_t *sh, size_t off, size_t len, char *buf)
+{
+    ssize_t ret = char_hw_read_data(hw, off, len, buf);
+    size_t n = off < sh->size ? (len < sh->size - off ? len : sh->size - off) : 0;
+
+    if(!sh->read_en)
+    {
+        CHECK(ret == -EPERM, "read %zu@%zu returned %zd", len, off, ret);
+        sh->stats.errors++;
+        return;
+    }
+    CHECK(ret == (ssize_t)n, "read %zu@%zu returned %zd, expected %zu", len, off, ret, n);
+    CHECK(memcmp(buf, sh->data + off, n) == 0, "read %zu@%zu returned wrong data", len, off);
+    sh->stats.read_ops++;
+    sh->stats.read_bytes += n;
+}
+
+static void do_write(char_dev_t *hw, shadow_t *sh, size_t off, size_t len, char *buf, uint8_t fill)
+{
+    size_t n = off < sh->size ? (len < sh->size - off ? len : sh->size - off) : 0;
+    ssize_t ret;
+
+    memset(buf, fill, len);
+    ret = char_hw_write_data(hw, off, len, buf);
+    if(!sh->write_en)
+    {
+        CHECK(ret == -EPERM, "write %zu@%zu returned %zd", len, off, ret);
+        sh->stats.errors++;
+        return;
+    }
+    if(n < len)
+    {
+        sh->overflow = true;
+        sh->stats.overflows++;
+        if(n == 0)
+        {
+            CHECK(ret == -ENOSPC, "write %zu@%zu returned %zd, expected -ENOSPC", len, off, ret);
+            return;
+        }
+    }
+    CHECK(ret == (ssize_t)n, "write %zu@%zu returned %zd, expected %zu", len, off, ret, n);
+    memset(sh->data + off, fill, n);
+    mark_written(sh, off, n);
+    sh->stats.write_ops++;
+    sh->stats.write_bytes += n;
+}
+
+static void do_fifo_write(char_dev_t *hw, shadow_t *sh, size_t len, uint8_t fill)
+{
+    size_t pos = sh->head % sh->size;
+    size_t n = len;
+    unsigned char *regs;
+    ssize_t ret;
+
+    if(n > sh->size - (sh->head - sh->tail))
+        n = sh->size - (sh->head - sh->tail);
+    if(n > sh->size - pos)
+        n = sh->size - pos;
+
+    ret = char_hw_fifo_write_begin(hw, len, &regs);
+    if(!sh->fifo_mode)
+    {
+        CHECK(ret == -ENOTCONN, "fifo write %zu in offset mode returned %zd", len, ret);
+        return;
+    }
+    if(!sh->write_en)
+    {
+        CHECK(ret == -EPERM, "fifo write %zu returned %zd", len, ret);
+        sh->stats.errors++;
+        return;
+    }
+    CHECK(ret == (ssize_t)n, "fifo write %zu returned %zd, expected %zu", len, ret, n);
+    if(ret == 0)
+        return;
+    CHECK(regs == hw->data_regs + pos, "fifo write at %zu, expected %zu", (size_t)(regs - hw->data_regs), pos);
+    memset(regs, fill, n);
+    char_hw_fifo_write_end(hw, n);
+
+    memset(sh->data + pos, fill, n);
+    mark_written(sh, pos, n);
+    sh->head += n;
+    if(sh->head - sh->tail == sh->size)
+        sh->overflow = true;
+    sh->stats.write_ops++;
+    sh->stats.write_bytes += n;
+}
+
+static void do_fifo_read(char_dev_t *hw, shadow_t *sh, size_t len)
+{
+    size_t pos = sh->tail % sh->size;
+    size_t n = len;
+    unsigned char *regs;
+    ssize_t ret;
+
+    if(n > sh->head - sh->tail)
+        n = sh->head - sh->tail;
+    if(n > sh->size - pos)
+        n = sh->size - pos;
+
+    ret = char_hw_fifo_read_begin(hw, len, &regs);
+    if(!sh->fifo_mode)
+    {
+        CHECK(ret == -ENOTCONN, "fifo read %zu in offset mode returned %zd", len, ret);
+        return;
+    }
+    if(!sh->read_en)
+    {
+        CHECK(ret == -EPERM, "fifo read %zu returned %zd", len, ret);
+        sh->stats.errors++;
+        return;
+    }
+    CHECK(ret == (ssize_t)n, "fifo read %zu returned %zd, expected %zu", len, ret, n);
+    if(ret == 0)
+        return;
+    CHECK(memcmp(regs, sh->data + pos, n) == 0, "fifo read %zu@%zu returned wrong data", n, pos);
+    char_hw_fifo_read_end(hw, n);
+
+    sh->tail += n;
+    sh->stats.read_ops++;
+    sh->stats.read_bytes += n;
+}
+
+static void do_snap_read(char_dev_t *hw, shadow_t *sh, char_snap_t *snap, size_t off, size_t len)
+{
+    unsigned char *regs;
+    ssize_t ret;
+
+    // a snapshot is read stripe by stripe
+    while(len > 0)
+    {
+        size_t n = off < sh->size ? (len < sh->size - off ? len : sh->size - off) : 0;
+
+        ret = char_hw_snap_read_begin(snap, off, len, &regs);
+        CHECK(ret >= 0 && (size_t)ret <= n, "snapshot read %zu@%zu returned %zd", len, off, ret);
+        if(ret == 0)
+        {
+            CHECK(n == 0, "snapshot read %zu@%zu returned 0", len, off);
+            return;
+        }
+        CHECK(memcmp(regs, sh->snap + off, ret) == 0, "snapshot read %zd@%zu returned wrong data", ret, off);
+        char_hw_snap_read_end(snap, off, ret, ret);
+
+        sh->stats.read_ops++;
+        sh->stats.read_bytes += ret;
+        off += ret;
+        len -= ret;
+    }
+}
+
+static void do_dirty(char_dev_t *hw, shadow_t *sh)
+{
+    unsigned char *regs;
+    size_t num_regs, i;
+    loff_t start = 0;
+    u64 epoch;
+    int ret;
+
+    ret = char_hw_dirty_begin(hw, false, &epoch);
+    CHECK(ret == 0, "dirty lookup returned %d", ret);
+    CHECK(epoch > sh->since, "dirty lookup epoch %llu after %llu", (unsigned long long)epoch,
+          (unsigned long long)sh->since);
+
+    // every register written since the last lookup is in a range
+    for(i = 0; i < sh->size; i++)
+    {
+        if(i >= (size_t)start)
+        {
+            start = char_hw_dirty_next(hw, sh->since, i, &num_regs, &regs);
+            if(start >= (loff_t)sh->size)
+                break;
+            CHECK(regs == hw->data_regs + start && num_regs > 0 && start + num_regs <= sh->size,
+                  "dirty range %zu@%lld", num_regs, (long long)start);
+            for(; i < (size_t)start; i++)
+                CHECK(!sh->dirty[i], "register %zu written since epoch %llu is not dirty", i,
+                      (unsigned long long)sh->since);
+            start += num_regs;
+        }
+    }
+    for(; i < sh->size; i++)
+        CHECK(!sh->dirty[i], "register %zu written since epoch %llu is not dirty", i,
+              (unsigned long long)sh->since);
+
+    char_hw_dirty_end(hw, false, 0);
+    sh->since = epoch;
+    memset(sh->dirty, 0, sh->size);
+}
+
+/* Function: Reference CRC32C (table driven, independent of the implementation under test) */
+static u32 ref_crc32c(u32 crc, const unsigned char *p, size_t len)
+{
+    static u32 table[256];
+    u32 c;
+    int i, k;
+
+    if(!table[1])
+    {
+        for(i = 0; i < 256; i++)
+        {
+            for(c = i, k = 0; k < 8; k++)
+                c = c & 1 ? (c >> 1) ^ 0x82f63b78 : c >> 1;
+            table[i] = c;
+        }
+    }
+    while(len--)
+        crc = table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    return crc;
+}
+
+static void do_crc(char_dev_t *hw, shadow_t *sh, size_t off, size_t len, u32 seed)
+{
+    size_t n = off < sh->size ? (len < sh->size - off ? len : sh->size - off) : 0;
+    u32 crc = seed;
+    ssize_t ret = char_hw_crc32c(hw, off, len, &crc);
+
+    if(!sh->read_en)
+    {
+        CHECK(ret == -EPERM, "crc32c %zu@%zu returned %zd", len, off, ret);
+        sh->stats.errors++;
+        return;
+    }
+    CHECK(ret == (ssize_t)n, "crc32c %zu@%zu returned %zd, expected %zu", len, off, ret, n);
+    CHECK(crc == ref_crc32c(seed, sh->data + off, n), "crc32c %zu@%zu returned 0x%08x", len, off, crc);
+    sh->stats.read_ops++;
+    sh->stats.read_bytes += n;
+}
+
+static void do_fill(char_dev_t *hw, shadow_t *sh, size_t off, size_t len, const unsigned char *pattern, size_t pattern_len)
+{
+    size_t n = off < sh->size ? (len < sh->size - off ? len : sh->size - off) : 0;
+    ssize_t ret = char_hw_fill_data(hw, off, len, pattern, pattern_len);
+    size_t i;
+
+    if(!sh->write_en)
+    {
+        CHECK(ret == -EPERM, "fill %zu@%zu returned %zd", len, off, ret);
+        sh->stats.errors++;
+        return;
+    }
+    if(n < len)
+    {
+        sh->overflow = true;
+        sh->stats.overflows++;
+        if(n == 0)
+        {
+            CHECK(ret == -ENOSPC, "fill %zu@%zu returned %zd, expected -ENOSPC", len, off, ret);
+            return;
+        }
+    }
+    CHECK(ret == (ssize_t)n, "fill %zu@%zu returned %zd, expected %zu", len, off, ret, n);
+    for(i = 0; i < n; i++)
+        sh->data[off + i] = pattern[i % pattern_len];
+    mark_written(sh, off, n);
+    sh->stats.write_ops++;
+    sh->stats.write_bytes += n;
+}
+
+static void do_compare(char_dev_t *hw, shadow_t *sh, size_t off, size_t len, char *buf, uint8_t flip)
+{
+    size_t n = off < sh->size ? (len < sh->size - off ? len : sh->size - off) : 0;
+    size_t mismatch, expected = n;
+    ssize_t ret;
+
+    // compare with the expected data, one register changed (if it is in the range)
+    if(n)
+        memcpy(buf, sh->data + off, n);
+    if(flip < n)
+    {
+        buf[flip] ^= 0x5a;
+        expected = flip;
+    }
+
+    ret = char_hw_compare_data(hw, off, len, buf, &mismatch);
+    if(!sh->read_en)
+    {
+        CHECK(ret == -EPERM, "compare %zu@%zu returned %zd", len, off, ret);
+        sh->stats.errors++;
+        return;
+    }
+    CHECK(ret == (ssize_t)expected && mismatch == expected, "compare %zu@%zu returned %zd, mismatch %zu, expected %zu",
+          len, off, ret, mismatch, expected);
+    sh->stats.read_ops++;
+    sh->stats.read_bytes += expected;
+}
+
+/* Function: Value of a 1/2/4/8-byte register in host byte order */
+static u64 reg_value(const unsigned char *p, unsigned int size)
+{
+    uint8_t v8;
+    uint16_t v16;
+    uint32_t v32;
+    uint64_t v64;
+
+    switch(size)
+    {
+        case 1: memcpy(&v8, p, 1); return v8;
+        case 2: memcpy(&v16, p, 2); return v16;
+        case 4: memcpy(&v32, p, 4); return v32;
+        default: memcpy(&v64, p, 8); return v64;
+    }
+}
+
+static void store_reg(unsigned char *p, unsigned int size, u64 v)
+{
+    uint8_t v8 = v;
+    uint16_t v16 = v;
+    uint32_t v32 = v;
+
+    switch(size)
+    {
+        case 1: memcpy(p, &v8, 1); break;
+        case 2: memcpy(p, &v16, 2); break;
+        case 4: memcpy(p, &v32, 4); break;
+        default: memcpy(p, &v, 8); break;
+    }
+}
+
+static void do_atomic(char_dev_t *hw, shadow_t *sh, size_t off, unsigned int size, unsigned int op, u64 operand, u64 expected)
+{
+    u64 old = 0, want, res;
+    int ret = char_hw_atomic(hw, off, size, op, operand, expected, &old);
+    bool store = true;
+
+    if(off % size || off + size > sh->size)
+    {
+        CHECK(ret == -EINVAL, "atomic %u %u@%zu returned %d", op, size, off, ret);
+        sh->stats.errors++;
+        return;
+    }
+    if(!sh->read_en || !sh->write_en)
+    {
+        CHECK(ret == -EPERM, "atomic %u %u@%zu returned %d", op, size, off, ret);
+        sh->stats.errors++;
+        return;
+    }
+    CHECK(ret == 0, "atomic %u %u@%zu returned %d", op, size, off, ret);
+
+    want = reg_value(sh->data + off, size);
+    CHECK(old == want, "atomic %u %u@%zu returned old 0x%llx, expected 0x%llx", op, size, off,
+          (unsigned long long)old, (unsigned long long)want);
+
+    switch(op)
+    {
+        case CHAR_HW_ATOMIC_ADD:
+            res = old + operand;
+            break;
+        case CHAR_HW_ATOMIC_CAS:
+            res = operand;
+            store = old == expected;
+            break;
+        case CHAR_HW_ATOMIC_XCHG:
+            res = operand;
+            break;
+        case CHAR_HW_ATOMIC_AND:
+            res = old & operand;
+            break;
+        default:
+            res = old | operand;
+            break;
+    }
+    if(store)
+        store_reg(sh->data + off, size, res);
+    mark_written(sh, off, size);
+    sh->stats.write_ops++;
+    sh->stats.write_bytes += size;
+}
+
+static void do_check(char_dev_t *hw, shadow_t *sh)
+{
+    unsigned char bits = (sh->read_en ? STS_READ_ACCESS_BIT : 0) | (sh->write_en ? STS_WRITE_ACCESS_BIT : 0) |
+                         (sh->overflow ? STS_DATAREGS_OVERFLOW_BIT : 0) | (sh->fifo_mode ? STS_FIFO_MODE_BIT : 0);
+    sts_regs_t status;
+    char_stats_t stats;
+
+    char_hw_get_status(hw, &status);
+    CHECK(status.device_status_reg == bits, "status 0x%02x, expected 0x%02x", status.device_status_reg, bits);
+    CHECK(char_hw_fifo_used(hw) == sh->head - sh->tail, "FIFO holds %zu, expected %lu",
+          char_hw_fifo_used(hw), sh->head - sh->tail);
+
+    char_hw_get_stats(hw, &stats);
+    CHECK(memcmp(&stats, &sh->stats, sizeof(stats)) == 0,
+          "statistics read %llu/%llu write %llu/%llu errors %llu overflows %llu, expected "
+          "read %llu/%llu write %llu/%llu errors %llu overflows %llu",
+          (unsigned long long)stats.read_ops, (unsigned long long)stats.read_bytes,
+          (unsigned long long)stats.write_ops, (unsigned long long)stats.write_bytes,
+          (unsigned long long)stats.errors, (unsigned long long)stats.overflows,
+          (unsigned long long)sh->stats.read_ops, (unsigned long long)sh->stats.read_bytes,
+          (unsigned long long)sh->stats.write_ops, (unsigned long long)sh->stats.write_bytes,
+          (unsigned long long)sh->stats.errors, (unsigned long long)sh->stats.overflows);
+}
+
+/* Function: Run the operations of one input on a new device */
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t len)
+{
+    input_t in = { data, len, 0 };
+    char_snap_t *snap = NULL;
+    char_dev_t hw = { 0 };
+    shadow_t sh = { 0 };
+    char *buf = NULL;
+    unsigned int dirty_shift;
+    int ret;
+
+    // Device geometry: size of data registers and of dirty chunks
+    sh.size = take(&in, 2) % FUZZ_MAX_DATA_SIZE + 1;
+    dirty_shift = take(&in, 1) % 16;
+    if(char_hw_init(&hw, sh.size, dirty_shift, NUMA_NO_NODE) < 0)
+        return 0;
+
+    sh.data = calloc(sh.size, 1);
+    sh.snap = calloc(sh.size, 1);
+    sh.dirty = malloc(sh.size);
+    buf = malloc(sh.size + 256);
+    if(!sh.data || !sh.snap || !sh.dirty || !buf)
+        goto out;
+    memset(sh.dirty, 1, sh.size); // epoch 0: everything
+    sh.read_en = sh.write_en = true;
+
+    while(in.pos < in.len)
+    {
+        unsigned int op = take(&in, 1) % NR_FUZZ_OPS;
+        size_t off = take(&in, 2) % (sh.size + 64);
+        size_t n = take(&in, 2) % (sh.size + 256);
+        uint8_t arg = take(&in, 1);
+
+        switch(op)
+        {
+            case FUZZ_READ:
+                do_read(&hw, &sh, off, n, buf);
+                break;
+            case FUZZ_WRITE:
+                do_write(&hw, &sh, off, n, buf, arg);
+                break;
+            case FUZZ_CLEAR:
+                ret = char_hw_clear_data(&hw);
+                if(!sh.write_en)
+                {
+                    CHECK(ret == -EPERM, "clear returned %d", ret);
+                    break;
+                }
+                CHECK(ret == 0, "clear returned %d", ret);
+                memset(sh.data, 0, sh.size);
+                mark_written(&sh, 0, sh.size);
+                sh.overflow = false;
+                sh.head = sh.tail = 0;
+                break;
+            case FUZZ_ENABLE_READ:
+                char_hw_enable_read(&hw, arg & 1);
+                sh.read_en = arg & 1;
+                break;
+            case FUZZ_ENABLE_WRITE:
+                char_hw_enable_write(&hw, arg & 1);
+                sh.write_en = arg & 1;
+                break;
+            case FUZZ_ENABLE_FIFO:
+                char_hw_enable_fifo(&hw, arg & 1);
+                CHECK(char_hw_fifo_mode(&hw) == (arg & 1), "FIFO mode %d, expected %d", char_hw_fifo_mode(&hw), arg & 1);
+                sh.fifo_mode = arg & 1;
+                sh.head = sh.tail = 0;
+                break;
+            case FUZZ_FIFO_WRITE:
+                do_fifo_write(&hw, &sh, n, arg);
+                break;
+            case FUZZ_FIFO_READ:
+                do_fifo_read(&hw, &sh, n);
+                break;
+            case FUZZ_SNAP:
+                if(snap)
+                {
+                    char_hw_snap_destroy(snap);
+                    snap = NULL;
+                    break;
+                }
+                snap = char_hw_snap_create(&hw, arg & 1);
+                if(!sh.read_en)
+                {
+                    CHECK(IS_ERR(snap) && PTR_ERR(snap) == -EPERM, "snapshot returned %ld", PTR_ERR(snap));
+                    snap = NULL;
+                    break;
+                }
+                if(sh.mapped)
+                {
+                    // stores through the mapping would leak into the snapshot
+                    CHECK(IS_ERR(snap) && PTR_ERR(snap) == -EBUSY, "snapshot with a mapping returned %ld", PTR_ERR(snap));
+                    snap = NULL;
+                    break;
+                }
+                CHECK(!IS_ERR(snap), "snapshot returned %ld", PTR_ERR(snap));
+                CHECK(snap->complete == (bool)(arg & 1), "snapshot complete %d, copy %d", snap->complete, arg & 1);
+                memcpy(sh.snap, sh.data, sh.size);
+                break;
+            case FUZZ_MAP:
+                if(sh.mapped)
+                {
+                    char_hw_put_wr_mapping(&hw);
+                    sh.mapped = false;
+                    break;
+                }
+                ret = char_hw_new_wr_mapping(&hw);
+                CHECK(ret == (snap ? -EBUSY : 0), "new mapping returned %d with snapshot %d", ret, snap != NULL);
+                sh.mapped = (ret == 0);
+                break;
+            case FUZZ_MAP_WRITE:
+                if(sh.mapped && off < sh.size)
+                {
+                    // not seen by the register model: no statistics, dirty since the mapping exists
+                    if(n > sh.size - off)
+                        n = sh.size - off;
+                    memset(hw.data_regs + off, arg, n);
+                    memset(sh.data + off, arg, n);
+                    mark_written(&sh, off, n);
+                }
+                break;
+            case FUZZ_SNAP_READ:
+                if(snap)
+                    do_snap_read(&hw, &sh, snap, off, n);
+                break;
+            case FUZZ_DIRTY:
+                do_dirty(&hw, &sh);
+                break;
+            case FUZZ_CRC:
+                do_crc(&hw, &sh, off, n, arg * 0x01010101u);
+                break;
+            case FUZZ_FILL:
+            {
+                unsigned char pattern[8];
+                size_t i;
+
+                for(i = 0; i < sizeof(pattern); i++)
+                    pattern[i] = arg + i * 37;
+                do_fill(&hw, &sh, off, n, pattern, arg % sizeof(pattern) + 1);
+            }
+                break;
+            case FUZZ_COMPARE:
+                do_compare(&hw, &sh, off, n, buf, arg);
+                break;
+            case FUZZ_ATOMIC:
+            {
+                unsigned int size = 1 << (arg & 3);
+                u64 operand = n * 0x9e3779b97f4a7c15ull, expected;
+
+                // mostly aligned registers, a compare-and-swap expecting the current value half of the time
+                if(!(arg & 0x80))
+                    off &= ~(size_t)(size - 1);
+                if(n & 1 && off + size <= sh.size)
+                    expected = reg_value(sh.data + off, size);
+                else
+                    expected = operand >> 7;
+                do_atomic(&hw, &sh, off, size, (arg >> 2) % CHAR_HW_NR_ATOMIC_OPS, operand, expected);
+            }
+                break;
+            default:
+                do_check(&hw, &sh);
+                break;
+        }
+    }
+    do_check(&hw, &sh);
+
+out:
+    if(snap)
+        char_hw_snap_destroy(snap);
+    if(sh.mapped)
+        char_hw_put_wr_mapping(&hw);
+    char_hw_exit(&hw);
+    free(buf);
+    free(sh.dirty);
+    free(sh.snap);
+    free(sh.data);
+    return 0;
+}
+
+#ifndef CHAR_HW_LIBFUZZER
+/* Function: Replay one input file */
+static int replay(const char *path)
+{
+    uint8_t *data = NULL;
+    size_t len = 0, cap = 0, n;
+    FILE *f = fopen(path, "rb");
+
+    if(!f)
+    {
+        perror(path);
+        return 1;
+    }
+    do
+    {
+        if(len == cap)
+        {
+            cap = cap ? cap * 2 : 4096;
+            data = realloc(data, cap);
+            if(!data)
+                abort();
+        }
+        n = fread(data + len, 1, cap - len, f);
+        len += n;
+    } while(n > 0);
+    fclose(f);
+
+    LLVMFuzzerTestOneInput(data, len);
+    free(data);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned long runs = 10000, run;
+    size_t len = 4096, i;
+    unsigned int seed = 1;
+    uint8_t *data;
+    int opt, ret = 0;
+
+    while((opt = getopt(argc, argv, "n:l:s:h")) != -1)
+    {
+        switch(opt)
+        {
+            case 'n':
+                runs = strtoul(optarg, NULL, 0);
+                break;
+            case 'l':
+                len = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                seed = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-n RUNS] [-l LENGTH] [-s SEED] [FILE...]\n", argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    if(optind < argc)
+    {
+        for(; optind < argc; optind++)
+            ret |= replay(argv[optind]);
+        return ret;
+    }
+
+    data = malloc(len);
+    if(!data)
+        return 1;
+    srand(seed);
+    for(run = 0; run < runs; run++)
+    {
+        for(i = 0; i < len; i++)
+            data[i] = rand();
+        LLVMFuzzerTestOneInput(data, len);
+    }
+    free(data);
+    printf("%lu runs of %zu bytes passed (seed %u)\n", runs, len, seed);
+    return 0;
+}
+#endif
@@ -15,7 +15,7 @@ typedef struct
 } status_t;
 
 #define BUFFER_SIZE 1024
-#define DEVICE_NODE "/dev/char_device_file"
+#define DEVICE_NODE "/dev/char_device_file0"
 
 /* Define ioctl commands code */
 #define MAGICAL_NUMBER 243
@@ -47,15 +47,29 @@ void close_chardev(int fd)
     close(fd);
 }
 
+/* Functions: Use the opened device file, or open it only for one operation */
+int get_chardev(int fd)
+{
+    return (fd < 0) ? open_chardev() : fd;
+}
+
+void put_chardev(int fd, int shared_fd)
+{
+    if(fd != shared_fd)
+        close_chardev(fd);
+}
+
 /* Function: Entry point READ of char driver*/
-void read_data_chardev()
+void read_data_chardev(int shared_fd)
 {
     int ret = 0;
     char user_buf[BUFFER_SIZE];
 
-    int fd = open_chardev(); // System call for opening device file
-    ret = read(fd, user_buf, BUFFER_SIZE); // System call for reading data from device file
-    close_chardev(fd); // System call for closing device file
+    int fd = get_chardev(shared_fd); // System call for opening device file (if not opened yet)
+    ret = pread(fd, user_buf, BUFFER_SIZE - 1, 0); // System call for reading data from the first data register
+    put_chardev(fd, shared_fd); // System call for closing device file (if opened above)
+    if(ret >= 0)
+        user_buf[ret] = '\0';
 
 
     // Check result
@@ -66,16 +80,16 @@ void read_data_chardev()
 }
 
 /* Function: Entry point WRITE of char driver*/
-void write_data_chardev()
+void write_data_chardev(int shared_fd)
 {
     int ret = 0;
     char user_buf[BUFFER_SIZE];
     printf("Enter your messsage: ");
     scanf(" %[^\n]s", user_buf);
 
-    int fd = open_chardev(); // System call for opening device file
-    ret = write(fd, user_buf, strlen(user_buf) + 1); // System call for writing the message into device file
-    close_chardev(fd); // System call for closing device file
+    int fd = get_chardev(shared_fd); // System call for opening device file (if not opened yet)
+    ret = pwrite(fd, user_buf, strlen(user_buf) + 1, 0); // System call for writing the message from the first data register
+    put_chardev(fd, shared_fd); // System call for closing device file (if opened above)
 
     // Check result
     if(ret < 0)
@@ -85,16 +99,16 @@ void write_data_chardev()
 }
 
 /* Function: Entry point CLEAR of char driver*/
-void clear_data_chardev()
+void clear_data_chardev(int shared_fd)
 {
-    int fd = open_chardev(); // open device file
+    int fd = get_chardev(shared_fd); // open device file (if not opened yet)
     int ret = ioctl(fd, CLEAR_DATA_CHARDEV); // clear data registers
-    close_chardev(fd); // close device file
+    put_chardev(fd, shared_fd); // close device file (if opened above)
     printf("%s data registers in char device\n", (ret < 0)?"Could not clear":"Clear");
 }
 
 /* Function: Entry point CONTROL_READ of char driver*/
-void control_read_chardev()
+void control_read_chardev(int shared_fd)
 {   
     unsigned char isReadable = 0;
     status_t status;
@@ -109,10 +123,10 @@ void control_read_chardev()
     else 
         return;
 
-    int fd = open_chardev(); // open device file
+    int fd = get_chardev(shared_fd); // open device file (if not opened yet)
     ioctl(fd, CTRL_READ_CHARDEV, (unsigned char*)&isReadable); // set permission
     ioctl(fd, GET_STATUS_CHARDEV, (status_t*)&status); // get status from  status registers
-    close_chardev(fd); // close device file
+    put_chardev(fd, shared_fd); // close device file (if opened above)
     
     if(status.device_status & 0x01)
         printf("Enable to read from data registers successful\n");
@@ -121,7 +135,7 @@ void control_read_chardev()
 }
 
 /* Function: Entry point CONTROL_WRITE of char driver*/
-void control_write_chardev()
+void control_write_chardev(int shared_fd)
 {   
     unsigned char isWriteable = 0;
     status_t status;
@@ -136,10 +150,10 @@ void control_write_chardev()
     else 
         return;
 
-    int fd = open_chardev(); // open device file
+    int fd = get_chardev(shared_fd); // open device file (if not opened yet)
     ioctl(fd, CTRL_WRITE_CHARDEV, (unsigned char*)&isWriteable); // set permission
     ioctl(fd, GET_STATUS_CHARDEV, (status_t*)&status); // get status from status registers
-    close_chardev(fd); // close device file
+    put_chardev(fd, shared_fd); // close device file (if opened above)
     
     if(status.device_status & 0x01)
         printf("Enable to write to data registers successful\n");
@@ -148,14 +162,14 @@ void control_write_chardev()
 }   
 
 /* Function: Entry point GET_STATUS of char driver*/
-void get_status_chardev()
+void get_status_chardev(int shared_fd)
 {
     status_t status;
     unsigned int read_cnt, write_cnt;
 
-    int fd = open_chardev(); // open device file
+    int fd = get_chardev(shared_fd); // open device file (if not opened yet)
     ioctl(fd, GET_STATUS_CHARDEV, (status_t*)&status); // get status from status registers
-    close_chardev(fd); // close device file
+    put_chardev(fd, shared_fd); // close device file (if opened above)
     
     switch(status.device_status)
     {
@@ -218,22 +232,22 @@ int main()
                 fd = -1;
                 break;
             case 'r':
-                read_data_chardev();
+                read_data_chardev(fd);
                 break; 
             case 'w':
-                write_data_chardev();
+                write_data_chardev(fd);
                 break;
             case 'C':
-                clear_data_chardev();   
+                clear_data_chardev(fd);   
                 break;
             case 'R':
-                control_read_chardev();  
+                control_read_chardev(fd);  
                 break;
             case 'W':
-                control_write_chardev(); 
+                control_write_chardev(fd); 
                 break;
             case 's':
-                get_status_chardev();    
+                get_status_chardev(fd);    
                 break; 
             case 'q':
                 if (fd > -1)